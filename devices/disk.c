@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -48,6 +49,9 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors a single READ/WRITE SECTOR command can transfer. */
+#define MAX_SECTORS_PER_CMD 256
+
 /* An ATA device. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
@@ -59,6 +63,8 @@ struct disk {
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	long long read_ops;         /* Number of read commands issued. */
+	long long write_ops;        /* Number of write commands issued. */
 };
 
 /* An ATA channel (aka controller).
@@ -84,7 +90,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -134,6 +140,7 @@ disk_init (void) {
 			d->capacity = 0;
 
 			d->read_cnt = d->write_cnt = 0;
+			d->read_ops = d->write_ops = 0;
 		}
 
 		/* Register interrupt handler. */
@@ -167,8 +174,8 @@ disk_print_stats (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
 			if (d != NULL && d->is_ata)
-				printf ("%s: %lld reads, %lld writes\n",
-						d->name, d->read_cnt, d->write_cnt);
+				printf ("%s: %lld reads, %lld writes (%lld read ops, %lld write ops)\n",
+						d->name, d->read_cnt, d->write_cnt, d->read_ops, d->write_ops);
 		}
 	}
 }
@@ -210,20 +217,23 @@ disk_size (struct disk *d) {
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 	struct channel *c;
+	uint64_t start = rdtsc ();
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
 	sema_down (&c->completion_wait);
 	if (!wait_while_busy (d))
 		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
 	input_sector (c, buffer);
 	d->read_cnt++;
+	d->read_ops++;
 	lock_release (&c->lock);
+	thread_current ()->disk_cycles += rdtsc () - start;
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -234,20 +244,126 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	struct channel *c;
+	uint64_t start = rdtsc ();
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
 	if (!wait_while_busy (d))
 		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
 	output_sector (c, buffer);
 	sema_down (&c->completion_wait);
 	d->write_cnt++;
+	d->write_ops++;
+	lock_release (&c->lock);
+	thread_current ()->disk_cycles += rdtsc () - start;
+}
+
+/* Returns the total number of sectors described by the IOV_CNT
+   entries of IOV. */
+static size_t
+iov_sectors (const struct disk_iov *iov, size_t iov_cnt) {
+	size_t cnt = 0;
+	size_t i;
+
+	for (i = 0; i < iov_cnt; i++)
+		cnt += iov[i].sector_cnt;
+	return cnt;
+}
+
+/* Reads consecutive sectors starting at SEC_NO from disk D into
+   the IOV_CNT buffers of IOV, filling each in turn.  Up to
+   MAX_SECTORS_PER_CMD sectors are transferred by a single READ
+   SECTOR command, so a run of sectors costs one request instead
+   of one per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_readv (struct disk *d, disk_sector_t sec_no,
+		const struct disk_iov *iov, size_t iov_cnt) {
+	struct channel *c;
+	uint64_t start = rdtsc ();
+	size_t left, i = 0, ofs = 0;
+
+	ASSERT (d != NULL);
+	ASSERT (iov != NULL);
+
+	c = d->channel;
+	left = iov_sectors (iov, iov_cnt);
+	lock_acquire (&c->lock);
+	while (left > 0) {
+		size_t cnt = left < MAX_SECTORS_PER_CMD ? left : MAX_SECTORS_PER_CMD;
+		size_t k;
+
+		select_sector (d, sec_no, cnt);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		for (k = 0; k < cnt; k++) {
+			/* The device interrupts once per sector it has ready. */
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, (disk_sector_t) (sec_no + k));
+			while (ofs == iov[i].sector_cnt) {
+				i++;
+				ofs = 0;
+			}
+			input_sector (c, (uint8_t *) iov[i].buffer + ofs++ * DISK_SECTOR_SIZE);
+		}
+		d->read_cnt += cnt;
+		d->read_ops++;
+		sec_no += cnt;
+		left -= cnt;
+	}
+	lock_release (&c->lock);
+	thread_current ()->disk_cycles += rdtsc () - start;
+}
+
+/* Writes consecutive sectors starting at SEC_NO on disk D from
+   the IOV_CNT buffers of IOV, as disk_readv() does for reads.
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_writev (struct disk *d, disk_sector_t sec_no,
+		const struct disk_iov *iov, size_t iov_cnt) {
+	struct channel *c;
+	uint64_t start = rdtsc ();
+	size_t left, i = 0, ofs = 0;
+
+	ASSERT (d != NULL);
+	ASSERT (iov != NULL);
+
+	c = d->channel;
+	left = iov_sectors (iov, iov_cnt);
+	lock_acquire (&c->lock);
+	while (left > 0) {
+		size_t cnt = left < MAX_SECTORS_PER_CMD ? left : MAX_SECTORS_PER_CMD;
+		size_t k;
+
+		select_sector (d, sec_no, cnt);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		for (k = 0; k < cnt; k++) {
+			/* The device asks for each sector in turn and interrupts
+			   once it has taken it. */
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, (disk_sector_t) (sec_no + k));
+			while (ofs == iov[i].sector_cnt) {
+				i++;
+				ofs = 0;
+			}
+			output_sector (c, (const uint8_t *) iov[i].buffer + ofs++ * DISK_SECTOR_SIZE);
+			sema_down (&c->completion_wait);
+		}
+		d->write_cnt += cnt;
+		d->write_ops++;
+		sec_no += cnt;
+		left -= cnt;
+	}
 	lock_release (&c->lock);
+	thread_current ()->disk_cycles += rdtsc () - start;
 }
 
 /* Disk detection and identification. */
@@ -402,17 +518,18 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -0,0 +1,352 @@
+/* cache.c: Sector buffer cache.
+ *
+ * Every sector the inode layer reads or writes goes through a fixed
+ * set of CACHE_SIZE buffers, replaced by the clock algorithm.  Writes
+ * only dirty a buffer; dirty buffers reach the disk when they are
+ * evicted, when the flusher thread finds them dirty for DIRTY_EXPIRE
+ * ticks, and in cache_flush() at shutdown.  Reads may queue the sector
+ * that follows for a read-ahead thread to bring in meanwhile.
+ *
+ * A buffer written by cache_write_logged() is held: it stays in the
+ * cache, and off the disk, until the journal has logged it and calls
+ * cache_unhold().
+ *
+ * cache_read_direct() reads sectors the cache does not hold straight
+ * into the caller's buffer, leaving the cache alone; a sector that is
+ * cached may be newer there than on disk, so it is always copied out.
+ *
+ * CACHE_LOCK protects the buffer headers.  Disk I/O on a buffer runs
+ * without it, with the buffer marked busy; anyone else who wants the
+ * buffer waits on IO_DONE.  Data is copied in and out of a buffer
+ * without the lock while the buffer is pinned, so that it is not
+ * evicted meanwhile. */
+
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)  /* Ticks between flusher runs. */
+#define DIRTY_EXPIRE (30 * TIMER_FREQ)   /* Ticks a buffer may stay dirty. */
+#define READ_AHEAD_MAX 8        /* Sectors waiting for read-ahead. */
+
+/* A cached sector. */
+struct cache_entry {
+	disk_sector_t sector;       /* Sector held, if VALID. */
+	bool valid;                 /* Holds a sector. */
+	bool dirty;                 /* Changed since read or written. */
+	int64_t dirty_since;        /* Timer tick it became dirty. */
+	bool accessed;              /* Used since the clock hand passed. */
+	bool busy;                  /* Being read, written or overwritten. */
+	bool overwrite;             /* Handed out to be overwritten whole. */
+	bool held;                  /* Not to be written until unheld. */
+	int pin_cnt;                /* Users copying to or from DATA. */
+	uint8_t data[DISK_SECTOR_SIZE];
+};
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static struct condition io_done;    /* A buffer stopped being busy. */
+static size_t hand;                 /* Clock hand. */
+
+/* Read-ahead queue. */
+static disk_sector_t read_ahead_queue[READ_AHEAD_MAX];
+static size_t read_ahead_cnt;
+static struct condition read_ahead_cond;
+
+/* Statistics. */
+static long long hit_cnt, miss_cnt, write_back_cnt, direct_cnt;
+
+static void cache_write_back (bool all);
+static void cache_flushd (void *aux);
+static void cache_read_aheadd (void *aux);
+static struct cache_entry *cache_get (disk_sector_t, bool fill);
+static void cache_put (struct cache_entry *, bool dirty, bool held);
+static struct cache_entry *cache_find (disk_sector_t);
+static struct cache_entry *cache_evict (void);
+
+/* Initializes the buffer cache and starts its threads. */
+void
+cache_init (void) {
+	lock_init (&cache_lock);
+	cond_init (&io_done);
+	cond_init (&read_ahead_cond);
+	thread_create ("cache_flushd", PRI_DEFAULT, cache_flushd, NULL);
+	thread_create ("cache_read_aheadd", PRI_DEFAULT, cache_read_aheadd, NULL);
+}
+
+/* Copies SIZE bytes at offset OFS of SECTOR into BUFFER. */
+void
+cache_read (disk_sector_t sector, void *buffer, size_t ofs, size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+	e = cache_get (sector, true);
+	memcpy (buffer, e->data + ofs, size);
+	cache_put (e, false, false);
+}
+
+/* Reads up to CNT consecutive sectors starting at SECTOR from disk
+ * into BUFFER, bypassing the cache, stopping before the first one the
+ * cache holds.  Returns the number of sectors read, which is 0 if
+ * SECTOR itself is cached.  BUFFER must not page fault, since the
+ * disk is read with its channel locked. */
+size_t
+cache_read_direct (disk_sector_t sector, size_t cnt, void *buffer) {
+	struct disk_iov iov;
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < cnt; i++)
+		if (cache_find (sector + i) != NULL)
+			break;
+	direct_cnt += i;
+	lock_release (&cache_lock);
+
+	if (i > 0) {
+		iov.buffer = buffer;
+		iov.sector_cnt = i;
+		disk_readv (filesys_disk, sector, &iov, 1);
+	}
+	return i;
+}
+
+/* Copies SIZE bytes from BUFFER to offset OFS of SECTOR.  A write of
+ * the whole sector does not read it first. */
+void
+cache_write (disk_sector_t sector, const void *buffer, size_t ofs,
+		size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+	e = cache_get (sector, size < DISK_SECTOR_SIZE);
+	memcpy (e->data + ofs, buffer, size);
+	cache_put (e, true, false);
+}
+
+/* Like cache_write(), but also holds SECTOR in the cache until
+ * cache_unhold(), for the journal. */
+void
+cache_write_logged (disk_sector_t sector, const void *buffer, size_t ofs,
+		size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+	e = cache_get (sector, size < DISK_SECTOR_SIZE);
+	memcpy (e->data + ofs, buffer, size);
+	cache_put (e, true, true);
+}
+
+/* Lets SECTOR, held by cache_write_logged(), be written to disk
+ * again. */
+void
+cache_unhold (disk_sector_t sector) {
+	struct cache_entry *e;
+
+	lock_acquire (&cache_lock);
+	e = cache_find (sector);
+	if (e != NULL)
+		e->held = false;
+	lock_release (&cache_lock);
+}
+
+/* Asks for SECTOR to be read into the cache in the background.  The
+ * request is dropped if the queue is full. */
+void
+cache_read_ahead (disk_sector_t sector) {
+	lock_acquire (&cache_lock);
+	if (cache_find (sector) == NULL && read_ahead_cnt < READ_AHEAD_MAX) {
+		read_ahead_queue[read_ahead_cnt++] = sector;
+		cond_signal (&read_ahead_cond, &cache_lock);
+	}
+	lock_release (&cache_lock);
+}
+
+/* Writes every dirty buffer to disk. */
+void
+cache_flush (void) {
+	cache_write_back (true);
+}
+
+/* Writes dirty buffers to disk: all of them if ALL, otherwise those
+ * dirty for DIRTY_EXPIRE ticks. */
+static void
+cache_write_back (bool all) {
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[i];
+
+		while (e->busy)
+			cond_wait (&io_done, &cache_lock);
+		if (!e->valid || !e->dirty || e->held
+				|| (!all && timer_elapsed (e->dirty_since) < DIRTY_EXPIRE))
+			continue;
+
+		/* Writes that land during the I/O dirty the buffer again. */
+		e->busy = true;
+		e->dirty = false;
+		lock_release (&cache_lock);
+		disk_write (filesys_disk, e->sector, e->data);
+		lock_acquire (&cache_lock);
+		e->busy = false;
+		write_back_cnt++;
+		cond_broadcast (&io_done, &cache_lock);
+	}
+	lock_release (&cache_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void) {
+	printf ("Buffer cache: %lld hits, %lld misses, %lld write-backs, "
+			"%lld sectors read directly\n",
+			hit_cnt, miss_cnt, write_back_cnt, direct_cnt);
+}
+
+/* Writes expired dirty buffers behind every FLUSH_INTERVAL ticks. */
+static void
+cache_flushd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FLUSH_INTERVAL);
+		cache_write_back (false);
+	}
+}
+
+/* Reads the sectors queued by cache_read_ahead(). */
+static void
+cache_read_aheadd (void *aux UNUSED) {
+	for (;;) {
+		disk_sector_t sector;
+
+		lock_acquire (&cache_lock);
+		while (read_ahead_cnt == 0)
+			cond_wait (&read_ahead_cond, &cache_lock);
+		sector = read_ahead_queue[0];
+		memmove (read_ahead_queue, read_ahead_queue + 1,
+				--read_ahead_cnt * sizeof *read_ahead_queue);
+		lock_release (&cache_lock);
+
+		cache_put (cache_get (sector, true), false, false);
+	}
+}
+
+/* Returns the buffer holding SECTOR, pinned, reading the sector in
+ * first if FILL.  Without FILL the caller overwrites the whole sector,
+ * and the buffer, if it was not cached, stays busy until cache_put()
+ * so that nobody reads it half written. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool fill) {
+	struct cache_entry *e;
+
+	lock_acquire (&cache_lock);
+	for (;;) {
+		e = cache_find (sector);
+		if (e != NULL) {
+			if (e->busy) {
+				cond_wait (&io_done, &cache_lock);
+				continue;
+			}
+			hit_cnt++;
+			break;
+		}
+
+		e = cache_evict ();
+		if (e == NULL) {  // 모든 buffer가 사용 중
+			cond_wait (&io_done, &cache_lock);
+			continue;
+		}
+		if (e->valid && e->dirty) {
+			/* The buffer may be wanted while it is written, so look
+			 * again afterward. */
+			e->busy = true;
+			e->dirty = false;
+			lock_release (&cache_lock);
+			disk_write (filesys_disk, e->sector, e->data);
+			lock_acquire (&cache_lock);
+			e->busy = false;
+			write_back_cnt++;
+			cond_broadcast (&io_done, &cache_lock);
+			continue;
+		}
+
+		miss_cnt++;
+		e->sector = sector;
+		e->valid = true;
+		e->dirty = false;
+		e->busy = true;
+		e->overwrite = !fill;
+		if (fill) {
+			lock_release (&cache_lock);
+			disk_read (filesys_disk, sector, e->data);
+			lock_acquire (&cache_lock);
+			e->busy = false;
+			cond_broadcast (&io_done, &cache_lock);
+		}
+		break;
+	}
+	e->accessed = true;
+	e->pin_cnt++;
+	lock_release (&cache_lock);
+	return e;
+}
+
+/* Unpins E, marking it dirty if DIRTY and held if HELD. */
+static void
+cache_put (struct cache_entry *e, bool dirty, bool held) {
+	lock_acquire (&cache_lock);
+	if (held)
+		e->held = true;
+	if (dirty && !e->dirty) {
+		e->dirty = true;
+		e->dirty_since = timer_ticks ();
+	}
+	if (e->overwrite) {
+		e->overwrite = false;
+		e->busy = false;
+		cond_broadcast (&io_done, &cache_lock);
+	}
+	e->pin_cnt--;
+	lock_release (&cache_lock);
+}
+
+/* Returns the buffer holding SECTOR, or a null pointer.  Call with
+ * cache_lock held. */
+static struct cache_entry *
+cache_find (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < CACHE_SIZE; i++)
+		if (cache[i].valid && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Sweeps the clock hand to a buffer that is neither pinned, busy,
+ * held nor recently used, and returns it.  Returns a null pointer if
+ * every buffer is pinned, busy or held.  Call with cache_lock held. */
+static struct cache_entry *
+cache_evict (void) {
+	size_t i;
+
+	for (i = 0; i < 2 * CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[hand];
+
+		hand = (hand + 1) % CACHE_SIZE;
+		if (e->pin_cnt > 0 || e->busy || e->held)
+			continue;
+		if (!e->valid || !e->accessed)
+			return e;
+		e->accessed = false;
+	}
+	return NULL;
+}
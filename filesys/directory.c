@@ -1,7 +1,10 @@
 #include "filesys/directory.h"
+#include <hash.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <list.h>
+#include <round.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -19,11 +22,82 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* A directory is a file of DIR_BLOCK_SIZE blocks, each holding
+ * DIR_BLOCK_ENTRIES entries; no entry crosses a block boundary.
+ *
+ * A small directory is searched linearly.  Once its entries outgrow
+ * DIR_LINEAR_MAX blocks it is indexed, in the style of ext3's htree:
+ * block 0 becomes a struct dir_index, mapping ranges of name hashes
+ * to leaf blocks, so a lookup reads the index and a single leaf.  A
+ * full leaf is split in two at a hash boundary.  When the root index
+ * fills up, its slots move to an interior index block and the root
+ * maps hashes to interior blocks instead, each of which maps them to
+ * leaves; a full interior block is split like a leaf.  Only if the
+ * root fills up again, or a leaf cannot be split because all its
+ * names hash the same, is the directory marked overflowed: new
+ * entries then go to any free slot and lookups that miss in the leaf
+ * fall back to a linear search. */
+#define DIR_BLOCK_SIZE DISK_SECTOR_SIZE
+#define DIR_BLOCK_ENTRIES (DIR_BLOCK_SIZE / sizeof (struct dir_entry))
+#define DIR_LINEAR_MAX 2
+#define DIR_INDEX_MAGIC 0x48545245      /* "HTRE" */
+#define DIR_NODE_MAGIC 0x48544e44       /* "HTND" */
+#define DIR_INDEX_SLOTS 62
+
+/* Index of a hashed directory: the root, in its block 0, or an
+ * interior block.  Must be exactly DIR_BLOCK_SIZE bytes long. */
+struct dir_index {
+	uint32_t magic;                     /* DIR_INDEX_MAGIC or DIR_NODE_MAGIC. */
+	uint32_t cnt;                       /* Slots in use. */
+	uint32_t overflow;                  /* Entries may be outside their leaf. */
+	uint32_t levels;                    /* In the root, 1 if it maps to
+	                                       interior blocks, else 0. */
+	struct {
+		uint32_t hash;                  /* Lowest hash in the block. */
+		uint32_t block;                 /* Leaf or interior block. */
+	} slots[DIR_INDEX_SLOTS];           /* Sorted by HASH; the root's
+	                                       slots[0].hash is 0. */
+};
+
+/* An entry along with the hash of its name, for sorting. */
+struct hashed_entry {
+	uint32_t hash;
+	struct dir_entry e;
+};
+
+/* Free-slot hints: for recently used directories, the first block
+ * that may have a free slot.  A stale hint only wastes space, so the
+ * table needs no lock. */
+#define DIR_HINT_CNT 16
+static struct {
+	disk_sector_t sector;               /* Directory inode. */
+	size_t block;                       /* Blocks before it are full. */
+} hints[DIR_HINT_CNT];
+static size_t hint_next;
+
+static uint32_t name_hash (const char *);
+static bool read_index (const struct dir *, struct dir_index *);
+static size_t index_find (const struct dir_index *, uint32_t hash);
+static bool is_node (const struct dir_index *root, size_t block);
+static bool index_node (const struct dir *, const struct dir_index *root,
+		uint32_t hash, struct dir_index *node, size_t *nodep);
+static bool index_grow (struct dir *, struct dir_index *root,
+		struct dir_index *node, size_t node_block, uint32_t hash);
+static bool index_add (struct dir *, struct dir_index *,
+		const struct dir_entry *);
+static bool linear_add (struct dir *, const struct dir_index *root,
+		const struct dir_entry *);
+static bool make_index (struct dir *);
+static size_t hint_get (disk_sector_t);
+static void hint_set (disk_sector_t, size_t block);
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
-	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+	hint_set (sector, 0);
+	return inode_create (sector,
+			DIV_ROUND_UP (entry_cnt, DIR_BLOCK_ENTRIES) * DIR_BLOCK_SIZE);
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -79,22 +153,65 @@ dir_get_inode (struct dir *dir) {
 static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
-	struct dir_entry e;
-	size_t ofs;
+	struct dir_index *idx, *node;
+	struct dir_entry *blk;
+	size_t block_cnt, b, i;
+	bool indexed, leaf, found = false;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (e.in_use && !strcmp (name, e.name)) {
-			if (ep != NULL)
-				*ep = e;
-			if (ofsp != NULL)
-				*ofsp = ofs;
-			return true;
+	idx = malloc (sizeof *idx);
+	node = malloc (sizeof *node);
+	blk = malloc (DIR_BLOCK_SIZE);
+	if (idx == NULL || node == NULL || blk == NULL)
+		goto done;
+	indexed = read_index (dir, idx);
+	block_cnt = inode_length (dir->inode) / DIR_BLOCK_SIZE;
+
+	/* Try the leaf for NAME's hash, then every block if that is all
+	 * an unindexed or overflowed directory can do.  The search skips
+	 * the index blocks. */
+	b = 0;
+	leaf = indexed;
+	if (indexed) {
+		uint32_t hash = name_hash (name);
+
+		if (!index_node (dir, idx, hash, node, &b))
+			goto done;
+		b = node->slots[index_find (node, hash)].block;
+	}
+	while (b < block_cnt) {
+		if (!leaf && indexed && is_node (idx, b)) {
+			b++;
+			continue;
 		}
-	return false;
+		if (inode_read_at (dir->inode, blk, DIR_BLOCK_SIZE, b * DIR_BLOCK_SIZE)
+				!= DIR_BLOCK_SIZE)
+			break;
+		for (i = 0; i < DIR_BLOCK_ENTRIES; i++)
+			if (blk[i].in_use && !strcmp (name, blk[i].name)) {
+				if (ep != NULL)
+					*ep = blk[i];
+				if (ofsp != NULL)
+					*ofsp = b * DIR_BLOCK_SIZE + i * sizeof *blk;
+				found = true;
+				goto done;
+			}
+		if (leaf) {
+			if (!idx->overflow)
+				break;
+			leaf = false;
+			b = 1;
+		} else
+			b++;
+	}
+
+done:
+	free (idx);
+	free (node);
+	free (blk);
+	return found;
 }
 
 /* Searches DIR for a file with the given NAME
@@ -125,8 +242,8 @@ dir_lookup (const struct dir *dir, const char *name,
  * error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+	struct dir_index *idx = NULL;
 	struct dir_entry e;
-	off_t ofs;
 	bool success = false;
 
 	ASSERT (dir != NULL);
@@ -140,25 +257,27 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
-
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
-
-	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
-	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+
+	idx = malloc (sizeof *idx);
+	if (idx == NULL)
+		goto done;
+	if (read_index (dir, idx)) {
+		success = index_add (dir, idx, &e);
+		if (!success && !idx->overflow) {
+			idx->overflow = true;
+			if (inode_write_at (dir->inode, idx, sizeof *idx, 0) != sizeof *idx)
+				goto done;
+		}
+		if (!success)
+			success = linear_add (dir, idx, &e);
+	} else
+		success = linear_add (dir, NULL, &e);
 
 done:
+	free (idx);
 	return success;
 }
 
@@ -189,6 +308,10 @@ dir_remove (struct dir *dir, const char *name) {
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
 
+	/* The freed slot is where the next entry may go. */
+	if ((size_t) ofs / DIR_BLOCK_SIZE < hint_get (inode_get_inumber (dir->inode)))
+		hint_set (inode_get_inumber (dir->inode), ofs / DIR_BLOCK_SIZE);
+
 	/* Remove inode. */
 	inode_remove (inode);
 	success = true;
@@ -203,14 +326,415 @@ done:
  * contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
+	struct dir_index *idx = malloc (sizeof *idx);
 	struct dir_entry e;
+	bool indexed, found = false;
 
-	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
+	if (idx == NULL)
+		return false;
+	indexed = read_index (dir, idx);
+	for (;;) {
+		size_t slot = dir->pos % DIR_BLOCK_SIZE / sizeof e;
+
+		/* Skip the padding at the end of a block, and index blocks. */
+		if (slot >= DIR_BLOCK_ENTRIES) {
+			dir->pos = ROUND_UP (dir->pos, DIR_BLOCK_SIZE);
+			continue;
+		}
+		if (dir->pos % DIR_BLOCK_SIZE == 0 && indexed
+				&& (dir->pos == 0 || is_node (idx, dir->pos / DIR_BLOCK_SIZE))) {
+			dir->pos += DIR_BLOCK_SIZE;
+			continue;
+		}
+
+		if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+			break;
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
+			break;
 		}
 	}
+	free (idx);
+	return found;
+}
+
+/* Returns the hash of NAME used by the directory index. */
+static uint32_t
+name_hash (const char *name) {
+	return hash_string (name);
+}
+
+/* Reads DIR's block 0 into IDX and returns true if DIR is indexed. */
+static bool
+read_index (const struct dir *dir, struct dir_index *idx) {
+	return inode_read_at (dir->inode, idx, sizeof *idx, 0) == sizeof *idx
+		&& idx->magic == DIR_INDEX_MAGIC;
+}
+
+/* Returns the slot of IDX whose leaf holds names hashing to HASH. */
+static size_t
+index_find (const struct dir_index *idx, uint32_t hash) {
+	size_t lo = 0, hi = idx->cnt;
+
+	/* Finds the last slot whose lowest hash is at most HASH. */
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (idx->slots[mid].hash <= hash)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Returns true if BLOCK of the directory whose root index is ROOT is
+ * an interior index block rather than a block of entries.  Only the
+ * root knows: a leaf may begin with any bytes at all. */
+static bool
+is_node (const struct dir_index *root, size_t block) {
+	size_t s;
+
+	if (root->levels != 1)
+		return false;
+	for (s = 0; s < root->cnt; s++)
+		if (root->slots[s].block == block)
+			return true;
 	return false;
 }
+
+/* Reads into NODE the index block of DIR, whose root is ROOT, that
+ * maps HASH to a leaf, and sets *NODEP to its block.  That is ROOT
+ * itself unless it has a level of interior blocks.  Returns false on
+ * a disk error. */
+static bool
+index_node (const struct dir *dir, const struct dir_index *root,
+		uint32_t hash, struct dir_index *node, size_t *nodep) {
+	if (root->levels == 0) {
+		*node = *root;
+		*nodep = 0;
+		return true;
+	}
+	*nodep = root->slots[index_find (root, hash)].block;
+	return inode_read_at (dir->inode, node, sizeof *node,
+			*nodep * DIR_BLOCK_SIZE) == sizeof *node
+		&& node->magic == DIR_NODE_MAGIC;
+}
+
+/* Makes room in NODE, the full index block of DIR at NODE_BLOCK that
+ * maps HASH, for another slot.  If ROOT has no interior blocks yet,
+ * moves its slots into a new one; otherwise splits NODE in two, adding
+ * a slot for the upper half to ROOT.  Returns false if ROOT is full
+ * too, or on a disk or memory error. */
+static bool
+index_grow (struct dir *dir, struct dir_index *root,
+		struct dir_index *node, size_t node_block, uint32_t hash) {
+	size_t new_block = inode_length (dir->inode) / DIR_BLOCK_SIZE;
+	struct dir_index *upper;
+	size_t s, half;
+	bool success;
+
+	if (root->levels == 0) {
+		node->magic = DIR_NODE_MAGIC;
+		node->overflow = false;
+		if (inode_write_at (dir->inode, node, sizeof *node,
+					new_block * DIR_BLOCK_SIZE) != sizeof *node)
+			return false;
+		root->levels = 1;
+		root->cnt = 1;
+		root->slots[0].hash = 0;
+		root->slots[0].block = new_block;
+		return inode_write_at (dir->inode, root, sizeof *root, 0)
+			== sizeof *root;
+	}
+
+	if (root->cnt == DIR_INDEX_SLOTS)
+		return false;
+	upper = calloc (1, sizeof *upper);
+	if (upper == NULL)
+		return false;
+	half = node->cnt / 2;
+	upper->magic = DIR_NODE_MAGIC;
+	upper->cnt = node->cnt - half;
+	memcpy (upper->slots, &node->slots[half],
+			upper->cnt * sizeof upper->slots[0]);
+	node->cnt = half;
+	success = inode_write_at (dir->inode, upper, sizeof *upper,
+				new_block * DIR_BLOCK_SIZE) == sizeof *upper
+		&& inode_write_at (dir->inode, node, sizeof *node,
+				node_block * DIR_BLOCK_SIZE) == sizeof *node;
+	if (success) {
+		s = index_find (root, hash);
+		memmove (&root->slots[s + 2], &root->slots[s + 1],
+				(root->cnt - s - 1) * sizeof root->slots[0]);
+		root->slots[s + 1].hash = upper->slots[0].hash;
+		root->slots[s + 1].block = new_block;
+		root->cnt++;
+		success = inode_write_at (dir->inode, root, sizeof *root, 0)
+			== sizeof *root;
+	}
+	free (upper);
+	return success;
+}
+
+/* Orders hashed entries by hash. */
+static int
+hashed_entry_cmp (const void *a_, const void *b_) {
+	const struct hashed_entry *a = a_, *b = b_;
+	return a->hash < b->hash ? -1 : a->hash > b->hash;
+}
+
+/* Adds E to the leaf of indexed directory DIR, whose root is IDX,
+ * that its name hashes to, splitting the leaf if it is full and
+ * growing the index if it has no slot for the new leaf.  Returns false
+ * if the leaf is full and cannot be split, or the index cannot grow,
+ * or on a disk or memory error. */
+static bool
+index_add (struct dir *dir, struct dir_index *idx,
+		const struct dir_entry *e) {
+	uint32_t hash = name_hash (e->name);
+	struct dir_index *node = malloc (sizeof *node);
+	struct dir_entry *blk = malloc (DIR_BLOCK_SIZE);
+	struct hashed_entry *he = NULL;
+	bool success = false;
+	size_t node_block, leaf, new_leaf, s, i, m;
+
+	if (node == NULL || blk == NULL
+			|| !index_node (dir, idx, hash, node, &node_block))
+		goto done;
+	leaf = node->slots[index_find (node, hash)].block;
+	if (inode_read_at (dir->inode, blk, DIR_BLOCK_SIZE,
+				leaf * DIR_BLOCK_SIZE) != DIR_BLOCK_SIZE)
+		goto done;
+	for (i = 0; i < DIR_BLOCK_ENTRIES; i++)
+		if (!blk[i].in_use) {
+			success = inode_write_at (dir->inode, e, sizeof *e,
+					leaf * DIR_BLOCK_SIZE + i * sizeof *e) == sizeof *e;
+			goto done;
+		}
+
+	/* The leaf is full: split it at the hash boundary nearest its
+	 * middle, moving the upper half to a new block. */
+	he = malloc (DIR_BLOCK_ENTRIES * sizeof *he);
+	if (he == NULL)
+		goto done;
+	for (i = 0; i < DIR_BLOCK_ENTRIES; i++) {
+		he[i].hash = name_hash (blk[i].name);
+		he[i].e = blk[i];
+	}
+	qsort (he, DIR_BLOCK_ENTRIES, sizeof *he, hashed_entry_cmp);
+	for (m = DIR_BLOCK_ENTRIES / 2; m < DIR_BLOCK_ENTRIES; m++)
+		if (he[m].hash != he[m - 1].hash)
+			break;
+	if (m == DIR_BLOCK_ENTRIES)
+		for (m = DIR_BLOCK_ENTRIES / 2; m > 0; m--)
+			if (he[m].hash != he[m - 1].hash)
+				break;
+	if (m == 0)
+		goto done;
+
+	/* Make room in the index for the new leaf. */
+	while (node->cnt == DIR_INDEX_SLOTS)
+		if (!index_grow (dir, idx, node, node_block, hash)
+				|| !index_node (dir, idx, hash, node, &node_block))
+			goto done;
+	s = index_find (node, hash);
+	new_leaf = inode_length (dir->inode) / DIR_BLOCK_SIZE;
+
+	memset (blk, 0, DIR_BLOCK_SIZE);
+	for (i = m; i < DIR_BLOCK_ENTRIES; i++)
+		blk[i - m] = he[i].e;
+	if (hash >= he[m].hash)
+		blk[DIR_BLOCK_ENTRIES - m] = *e;
+	if (inode_write_at (dir->inode, blk, DIR_BLOCK_SIZE,
+				new_leaf * DIR_BLOCK_SIZE) != DIR_BLOCK_SIZE)
+		goto done;
+	memset (blk, 0, DIR_BLOCK_SIZE);
+	for (i = 0; i < m; i++)
+		blk[i] = he[i].e;
+	if (hash < he[m].hash)
+		blk[m] = *e;
+	if (inode_write_at (dir->inode, blk, DIR_BLOCK_SIZE,
+				leaf * DIR_BLOCK_SIZE) != DIR_BLOCK_SIZE)
+		goto done;
+
+	memmove (&node->slots[s + 2], &node->slots[s + 1],
+			(node->cnt - s - 1) * sizeof node->slots[0]);
+	node->slots[s + 1].hash = he[m].hash;
+	node->slots[s + 1].block = new_leaf;
+	node->cnt++;
+	success = inode_write_at (dir->inode, node, sizeof *node,
+			node_block * DIR_BLOCK_SIZE) == sizeof *node;
+	if (node_block == 0)
+		*idx = *node;
+
+done:
+	free (he);
+	free (blk);
+	free (node);
+	return success;
+}
+
+/* Adds E to the first free slot of DIR, starting from its free-slot
+ * hint and skipping the index blocks of ROOT, DIR's root index if it
+ * is indexed, else a null pointer.  If every block is full, appends a
+ * block to DIR, unless DIR has DIR_LINEAR_MAX blocks and is not
+ * indexed yet, in which case it is indexed instead.  Returns false on
+ * a disk or memory error. */
+static bool
+linear_add (struct dir *dir, const struct dir_index *root,
+		const struct dir_entry *e) {
+	bool indexed = root != NULL;
+	disk_sector_t sector = inode_get_inumber (dir->inode);
+	size_t block_cnt = inode_length (dir->inode) / DIR_BLOCK_SIZE;
+	struct dir_entry *blk = calloc (1, DIR_BLOCK_SIZE);
+	bool success = false;
+	size_t b, i;
+
+	if (blk == NULL)
+		return false;
+
+	b = hint_get (sector);
+	if (indexed && b == 0)
+		b = 1;
+	for (; b < block_cnt; b++) {
+		if (indexed && is_node (root, b))
+			continue;
+		if (inode_read_at (dir->inode, blk, DIR_BLOCK_SIZE, b * DIR_BLOCK_SIZE)
+				!= DIR_BLOCK_SIZE)
+			goto done;
+		for (i = 0; i < DIR_BLOCK_ENTRIES; i++)
+			if (!blk[i].in_use) {
+				hint_set (sector, b);
+				success = inode_write_at (dir->inode, e, sizeof *e,
+						b * DIR_BLOCK_SIZE + i * sizeof *e) == sizeof *e;
+				goto done;
+			}
+	}
+
+	if (!indexed && block_cnt >= DIR_LINEAR_MAX) {
+		struct dir_index *idx = malloc (sizeof *idx);
+
+		success = (idx != NULL && make_index (dir) && read_index (dir, idx)
+				&& index_add (dir, idx, e));
+		free (idx);
+		goto done;
+	}
+
+	/* Every block is full: append one. */
+	memset (blk, 0, DIR_BLOCK_SIZE);
+	blk[0] = *e;
+	hint_set (sector, block_cnt);
+	success = inode_write_at (dir->inode, blk, DIR_BLOCK_SIZE,
+			block_cnt * DIR_BLOCK_SIZE) == DIR_BLOCK_SIZE;
+
+done:
+	free (blk);
+	return success;
+}
+
+/* Turns linear directory DIR into an indexed one: sorts its entries
+ * by hash into half-full leaves starting at block 1, and writes the
+ * index into block 0.  Returns false on a disk or memory error. */
+static bool
+make_index (struct dir *dir) {
+	size_t block_cnt = inode_length (dir->inode) / DIR_BLOCK_SIZE;
+	size_t per_leaf = DIR_BLOCK_ENTRIES / 2;
+	struct hashed_entry *he;
+	struct dir_entry *blk;
+	struct dir_index *idx;
+	size_t cnt = 0, leaf_cnt, b, i;
+	bool success = false;
+
+	he = malloc (block_cnt * DIR_BLOCK_ENTRIES * sizeof *he);
+	blk = malloc (DIR_BLOCK_SIZE);
+	idx = calloc (1, sizeof *idx);
+	if (he == NULL || blk == NULL || idx == NULL)
+		goto done;
+
+	for (b = 0; b < block_cnt; b++) {
+		if (inode_read_at (dir->inode, blk, DIR_BLOCK_SIZE, b * DIR_BLOCK_SIZE)
+				!= DIR_BLOCK_SIZE)
+			goto done;
+		for (i = 0; i < DIR_BLOCK_ENTRIES; i++)
+			if (blk[i].in_use) {
+				he[cnt].hash = name_hash (blk[i].name);
+				he[cnt++].e = blk[i];
+			}
+	}
+	qsort (he, cnt, sizeof *he, hashed_entry_cmp);
+
+	/* Fill leaves PER_LEAF entries at a time, starting a new leaf only
+	 * between different hashes.  A run of equal hashes too long for
+	 * one leaf overflows the directory. */
+	idx->magic = DIR_INDEX_MAGIC;
+	idx->cnt = 1;
+	idx->slots[0].hash = 0;
+	idx->slots[0].block = 1;
+	memset (blk, 0, DIR_BLOCK_SIZE);
+	for (i = 0, leaf_cnt = 0; i < cnt; i++) {
+		bool boundary = i > 0 && he[i].hash != he[i - 1].hash;
+
+		if (leaf_cnt == DIR_BLOCK_ENTRIES
+				|| (leaf_cnt >= per_leaf && boundary)) {
+			if (!boundary)
+				idx->overflow = true;
+			if (inode_write_at (dir->inode, blk, DIR_BLOCK_SIZE,
+						idx->slots[idx->cnt - 1].block * DIR_BLOCK_SIZE)
+					!= DIR_BLOCK_SIZE)
+				goto done;
+			idx->slots[idx->cnt].hash = he[i].hash;
+			idx->slots[idx->cnt].block = idx->cnt + 1;
+			idx->cnt++;
+			memset (blk, 0, DIR_BLOCK_SIZE);
+			leaf_cnt = 0;
+		}
+		blk[leaf_cnt++] = he[i].e;
+	}
+	if (inode_write_at (dir->inode, blk, DIR_BLOCK_SIZE,
+				idx->slots[idx->cnt - 1].block * DIR_BLOCK_SIZE) != DIR_BLOCK_SIZE)
+		goto done;
+
+	/* Clear blocks left over past the leaves. */
+	memset (blk, 0, DIR_BLOCK_SIZE);
+	for (b = idx->cnt + 1; b < block_cnt; b++)
+		if (inode_write_at (dir->inode, blk, DIR_BLOCK_SIZE, b * DIR_BLOCK_SIZE)
+				!= DIR_BLOCK_SIZE)
+			goto done;
+
+	hint_set (inode_get_inumber (dir->inode), 1);
+	success = inode_write_at (dir->inode, idx, sizeof *idx, 0) == sizeof *idx;
+
+done:
+	free (he);
+	free (blk);
+	free (idx);
+	return success;
+}
+
+/* Returns the free-slot hint for the directory at SECTOR. */
+static size_t
+hint_get (disk_sector_t sector) {
+	size_t i;
+
+	for (i = 0; i < DIR_HINT_CNT; i++)
+		if (hints[i].sector == sector)
+			return hints[i].block;
+	return 0;
+}
+
+/* Sets the free-slot hint for the directory at SECTOR to BLOCK. */
+static void
+hint_set (disk_sector_t sector, size_t block) {
+	size_t i;
+
+	for (i = 0; i < DIR_HINT_CNT; i++)
+		if (hints[i].sector == sector) {
+			hints[i].block = block;
+			return;
+		}
+	i = hint_next++ % DIR_HINT_CNT;
+	hints[i].sector = sector;
+	hints[i].block = block;
+}
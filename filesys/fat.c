@@ -3,9 +3,14 @@
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include <bitmap.h>
 #include <stdio.h>
 #include <string.h>
 
+/* A new chain starts where this many clusters are free, if it can,
+ * so that it has room to grow in one run. */
+#define FAT_RUN_RESERVE 8
+
 /* Should be less than DISK_SECTOR_SIZE */
 struct fat_boot {
 	unsigned int magic;
@@ -22,14 +27,16 @@ struct fat_fs {
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
-	struct lock write_lock;
+	cluster_t last_clst;            /* Where new chains are looked for. */
+	struct lock write_lock;         /* Held while chains are changed. */
+	struct bitmap *free_clusters;   /* Set bit: cluster is in use. */
 };
 
 static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
 void fat_fs_init (void);
+static cluster_t fat_alloc_cluster (cluster_t prev);
 
 void
 fat_init (void) {
@@ -78,6 +85,11 @@ fat_open (void) {
 			free (bounce);
 		}
 	}
+
+	/* Build the free-cluster bitmap from the FAT. */
+	for (cluster_t clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->free_clusters, clst);
 }
 
 void
@@ -152,7 +164,19 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	/* Cluster 0 is never used, so cluster 1 begins at DATA_START. */
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ SECTORS_PER_CLUSTER + 1;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
+	lock_init (&fat_fs->write_lock);
+
+	if (fat_fs->free_clusters != NULL)
+		bitmap_destroy (fat_fs->free_clusters);
+	fat_fs->free_clusters = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->free_clusters == NULL)
+		PANIC ("FAT init failed");
+	bitmap_mark (fat_fs->free_clusters, 0);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -164,30 +188,161 @@ fat_fs_init (void) {
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	cluster_t new;
+
+	lock_acquire (&fat_fs->write_lock);
+	new = fat_alloc_cluster (clst);
+	if (new != 0) {
+		fat_put (new, EOChain);
+		if (clst != 0)
+			fat_put (clst, new);
+	}
+	lock_release (&fat_fs->write_lock);
+	return new;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_put (pclst, EOChain);
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_get (clst);
+
+		fat_put (clst, 0);
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->free_clusters, clst, val != 0);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
+}
+
+/* Finds a free cluster to follow PREV, or to start a new chain if
+ * PREV is 0, from the free-cluster bitmap.  The cluster right after
+ * PREV is taken if free, so a growing chain stays one run; a new
+ * chain starts where FAT_RUN_RESERVE clusters are free if possible.
+ * Returns 0 if the disk is full.  Call with write_lock held. */
+static cluster_t
+fat_alloc_cluster (cluster_t prev) {
+	struct bitmap *b = fat_fs->free_clusters;
+	size_t clst;
+
+	if (prev != 0 && prev + 1 < fat_fs->fat_length
+			&& !bitmap_test (b, prev + 1))
+		return prev + 1;
+
+	if (fat_fs->last_clst >= fat_fs->fat_length)
+		fat_fs->last_clst = 1;
+	clst = BITMAP_ERROR;
+	if (prev == 0) {
+		clst = bitmap_scan (b, fat_fs->last_clst, FAT_RUN_RESERVE, false);
+		if (clst == BITMAP_ERROR)
+			clst = bitmap_scan (b, 1, FAT_RUN_RESERVE, false);
+	}
+	if (clst == BITMAP_ERROR)
+		clst = bitmap_scan (b, fat_fs->last_clst, 1, false);
+	if (clst == BITMAP_ERROR)
+		clst = bitmap_scan (b, 1, 1, false);
+	if (clst == BITMAP_ERROR)
+		return 0;
+
+	/* Leave the clusters after a new chain to its growth. */
+	fat_fs->last_clst = clst + (prev == 0 ? FAT_RUN_RESERVE : 1);
+	return clst;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Chain run cache                                                            */
+/*----------------------------------------------------------------------------*/
+
+/* Initializes CHAIN to map the chain starting at START, or an empty
+ * chain if START is 0.  Runs are read from the FAT as lookups need
+ * them. */
+void
+fat_chain_init (struct fat_chain *chain, cluster_t start) {
+	chain->start = start;
+	chain->runs = NULL;
+	chain->run_cnt = 0;
+	chain->run_cap = 0;
+}
+
+/* Frees the runs cached by CHAIN.  Call this, then fat_chain_init(),
+ * after the chain is cut short by fat_remove_chain(). */
+void
+fat_chain_destroy (struct fat_chain *chain) {
+	free (chain->runs);
+	chain->runs = NULL;
+	chain->run_cnt = chain->run_cap = 0;
+}
+
+/* Returns the IDXth cluster of CHAIN, or 0 if the chain is shorter
+ * than that or memory runs out.  The FAT is walked only past the
+ * clusters already cached, so clusters added to the end of the chain
+ * are picked up; after that a lookup is a binary search of the runs. */
+cluster_t
+fat_chain_lookup (struct fat_chain *chain, size_t idx) {
+	struct fat_run *last = chain->run_cnt > 0
+		? &chain->runs[chain->run_cnt - 1] : NULL;
+	size_t mapped = last != NULL ? last->ofs + last->cnt : 0;
+	size_t lo, hi;
+
+	while (idx >= mapped) {
+		cluster_t next = last != NULL
+			? fat_get (last->clst + last->cnt - 1) : chain->start;
+
+		if (next == 0 || next == EOChain)
+			return 0;
+		if (last != NULL && next == last->clst + last->cnt)
+			last->cnt++;
+		else {
+			if (chain->run_cnt == chain->run_cap) {
+				size_t cap = chain->run_cap > 0 ? chain->run_cap * 2 : 4;
+				struct fat_run *runs = realloc (chain->runs, cap * sizeof *runs);
+
+				if (runs == NULL)
+					return 0;
+				chain->runs = runs;
+				chain->run_cap = cap;
+			}
+			last = &chain->runs[chain->run_cnt++];
+			last->ofs = mapped;
+			last->clst = next;
+			last->cnt = 1;
+		}
+		mapped++;
+	}
+
+	/* Finds the last run that starts at or before IDX. */
+	lo = 0;
+	hi = chain->run_cnt;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (chain->runs[mid].ofs <= idx)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return chain->runs[lo].clst + (idx - chain->runs[lo].ofs);
 }
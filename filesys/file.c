@@ -86,6 +86,25 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
 	return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Like file_read(), but reads whole sectors from disk straight into
+ * BUFFER, which must not page fault (see inode_read_at_direct()). */
+off_t
+file_read_direct (struct file *file, void *buffer, off_t size) {
+	off_t bytes_read = inode_read_at_direct (file->inode, buffer, size,
+			file->pos);
+	file->pos += bytes_read;
+	return bytes_read;
+}
+
+/* Like file_read_at(), but reads whole sectors from disk straight
+ * into BUFFER, which must not page fault (see
+ * inode_read_at_direct()). */
+off_t
+file_read_at_direct (struct file *file, void *buffer, off_t size,
+		off_t file_ofs) {
+	return inode_read_at_direct (file->inode, buffer, size, file_ofs);
+}
+
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
@@ -1,12 +1,27 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
+
+/* Changes to the free map are not written at once.  Each marks the
+ * FREE_MAP_CHUNK-byte pieces of the map file it touched dirty, and
+ * free_map_sync() writes just those, at a journal commit or when the
+ * map is closed. */
+#define FREE_MAP_CHUNK DISK_SECTOR_SIZE
+#define CHUNK_BITS (FREE_MAP_CHUNK * 8)     /* Sectors covered by a chunk. */
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct bitmap *dirty_chunks;  /* Chunks of FREE_MAP not yet written. */
+static size_t cursor;                /* Where the next search starts. */
+static struct lock free_map_lock;    /* Guards the variables above. */
+
+static size_t scan_from_cursor (size_t cnt);
+static void mark (disk_sector_t, size_t cnt, bool value);
 
 /* Initializes the free map. */
 void
@@ -16,6 +31,13 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+	dirty_chunks = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+				FREE_MAP_CHUNK));
+	if (dirty_chunks == NULL)
+		PANIC ("bitmap creation failed--disk is too large");
+	cursor = JOURNAL_SECTOR + JOURNAL_SECTORS;
+	lock_init (&free_map_lock);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,24 +46,94 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
-	}
-	if (sector != BITMAP_ERROR)
+	size_t sector;
+
+	lock_acquire (&free_map_lock);
+	sector = scan_from_cursor (cnt);
+	if (sector != BITMAP_ERROR) {
+		mark (sector, cnt, true);
 		*sectorp = sector;
+	}
+	lock_release (&free_map_lock);
 	return sector != BITMAP_ERROR;
 }
 
+/* Allocates one run of up to CNT consecutive sectors for an extent,
+ * preferring a run that begins at GOAL so that a growing file stays
+ * sequential on disk, then any run of CNT sectors at or after GOAL,
+ * then one from the cursor on, then the first free run anywhere,
+ * however short.  Stores the first sector into *SECTORP and returns
+ * the number of sectors allocated, or 0 if the disk is full. */
+size_t
+free_map_allocate_extent (size_t cnt, disk_sector_t goal,
+		disk_sector_t *sectorp) {
+	size_t size = bitmap_size (free_map);
+	size_t start, run;
+
+	ASSERT (cnt > 0);
+
+	lock_acquire (&free_map_lock);
+	if (goal < size && !bitmap_test (free_map, goal))
+		start = goal;
+	else {
+		start = goal < size ? bitmap_scan (free_map, goal, cnt, false)
+			: BITMAP_ERROR;
+		if (start == BITMAP_ERROR)
+			start = scan_from_cursor (cnt);
+		if (start == BITMAP_ERROR)
+			start = scan_from_cursor (1);
+		if (start == BITMAP_ERROR) {
+			lock_release (&free_map_lock);
+			return 0;
+		}
+	}
+	for (run = 1; run < cnt && start + run < size
+			&& !bitmap_test (free_map, start + run); run++)
+		continue;
+
+	mark (start, run, true);
+	lock_release (&free_map_lock);
+	*sectorp = start;
+	return run;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
-	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	mark (sector, cnt, false);
+	lock_release (&free_map_lock);
+}
+
+/* Returns the number of chunks in the free map, the most sectors that
+ * free_map_sync() writes. */
+size_t
+free_map_chunk_cnt (void) {
+	return dirty_chunks != NULL ? bitmap_size (dirty_chunks) : 0;
+}
+
+/* Writes the dirty chunks of the free map to its file.  A chunk that
+ * fails to write stays dirty, to be written by the next call.
+ * Returns false if any chunk failed. */
+bool
+free_map_sync (void) {
+	bool success = true;
+	size_t i;
+
+	if (free_map_file == NULL)
+		return true;
+	lock_acquire (&free_map_lock);
+	for (i = 0; i < bitmap_size (dirty_chunks); i++)
+		if (bitmap_test (dirty_chunks, i)) {
+			if (bitmap_write_part (free_map, free_map_file, i * FREE_MAP_CHUNK,
+						FREE_MAP_CHUNK))
+				bitmap_reset (dirty_chunks, i);
+			else
+				success = false;
+		}
+	lock_release (&free_map_lock);
+	return success;
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -57,7 +149,10 @@ free_map_open (void) {
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) {
+	if (!free_map_sync ())
+		PANIC ("can't write free map");
 	file_close (free_map_file);
+	free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -74,4 +169,33 @@ free_map_create (void) {
 		PANIC ("can't open free map");
 	if (!bitmap_write (free_map, free_map_file))
 		PANIC ("can't write free map");
+	bitmap_set_all (dirty_chunks, false);
+}
+
+/* Finds CNT free sectors in a row, searching from the cursor to the
+ * end of the disk and then from the start, and moves the cursor past
+ * them.  Returns the first, or BITMAP_ERROR.  Call with free_map_lock
+ * held. */
+static size_t
+scan_from_cursor (size_t cnt) {
+	size_t sector = BITMAP_ERROR;
+
+	if (cursor < bitmap_size (free_map))
+		sector = bitmap_scan (free_map, cursor, cnt, false);
+	if (sector == BITMAP_ERROR)
+		sector = bitmap_scan (free_map, 0, cnt, false);
+	if (sector != BITMAP_ERROR)
+		cursor = sector + cnt;
+	return sector;
+}
+
+/* Sets CNT sectors starting at SECTOR to VALUE in the free map and
+ * marks the chunks holding them dirty.  Call with free_map_lock
+ * held. */
+static void
+mark (disk_sector_t sector, size_t cnt, bool value) {
+	bitmap_set_multiple (free_map, sector, cnt, value);
+	if (cnt > 0)
+		bitmap_set_multiple (dirty_chunks, sector / CHUNK_BITS,
+				(sector + cnt - 1) / CHUNK_BITS - sector / CHUNK_BITS + 1, true);
 }
@@ -1,23 +1,48 @@
 #include "filesys/inode.h"
-#include <list.h>
 #include <debug.h>
+#include <hash.h>
 #include <round.h>
+#include <stddef.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of consecutive data sectors. */
+struct extent {
+	disk_sector_t start;                /* First sector of the run. */
+	uint32_t cnt;                       /* Number of sectors. */
+};
+
+/* Extents held in the inode itself and in each indirect block. */
+#define DIRECT_EXTENT_CNT 62
+#define INDIRECT_EXTENT_CNT 63
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.  A file's data is a
+ * list of extents in file order: the first DIRECT_EXTENT_CNT are
+ * here, the rest in a chain of indirect blocks starting at
+ * INDIRECT. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	uint32_t extent_cnt;                /* Number of extents. */
+	disk_sector_t indirect;             /* First indirect block. */
+	struct extent extents[DIRECT_EXTENT_CNT];
+};
+
+/* Indirect block holding more extents of a file.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct extent_block {
+	disk_sector_t next;                 /* Next indirect block. */
+	uint32_t unused;                    /* Not used. */
+	struct extent extents[INDIRECT_EXTENT_CNT];
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -27,38 +52,110 @@ bytes_to_sectors (off_t size) {
 	return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+/* Returns the number of indirect blocks needed for EXTENT_CNT
+ * extents. */
+static inline size_t
+extents_to_blocks (size_t extent_cnt) {
+	return extent_cnt > DIRECT_EXTENT_CNT
+		? DIV_ROUND_UP (extent_cnt - DIRECT_EXTENT_CNT, INDIRECT_EXTENT_CNT) : 0;
+}
+
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
 	struct lock filesys_lock;						/* 배타적인 read & write를 지원하는 lock */
+
+	/* All extents, direct and indirect, in file order.  EXTENT_END[i]
+	 * is the file sector just past extent i, for binary search. */
+	struct lock extent_lock;            /* Guards the fields below. */
+	struct extent *extents;
+	size_t *extent_end;
+	size_t extent_cap;                  /* Allocated length of both. */
+	size_t sector_cnt;                  /* Data sectors allocated. */
+	disk_sector_t *blocks;              /* Indirect blocks, in chain order. */
+	size_t block_cnt;
 };
 
+static bool inode_load_extents (struct inode *);
+static bool inode_grow (struct inode *, off_t length);
+static void inode_shrink (struct inode *, size_t sector_cnt);
+static bool inode_add_extent (struct inode *, disk_sector_t, size_t cnt);
+static void inode_store (struct inode *, size_t first_extent);
+static off_t inode_read (struct inode *, void *, off_t size, off_t offset,
+		bool direct);
+
 /* Returns the disk sector that contains byte offset POS within
- * INODE.
+ * INODE, and if CNT is nonnull stores in *CNT how many sectors of the
+ * same extent start there, so that they lie one after another on disk.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_run (struct inode *inode, off_t pos, size_t *cnt) {
+	disk_sector_t sector = -1;
+
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
-		return -1;
+	lock_acquire (&inode->extent_lock);
+	if (pos < inode->data.length) {
+		size_t idx = pos / DISK_SECTOR_SIZE;
+		size_t lo = 0, hi = inode->data.extent_cnt;
+
+		/* Finds the first extent that ends past IDX. */
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if (inode->extent_end[mid] <= idx)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < inode->data.extent_cnt) {
+			sector = inode->extents[lo].start + inode->extents[lo].cnt
+				- (inode->extent_end[lo] - idx);
+			if (cnt != NULL)
+				*cnt = inode->extent_end[lo] - idx;
+		}
+	}
+	lock_release (&inode->extent_lock);
+	return sector;
+}
+
+/* Returns the disk sector that contains byte offset POS within
+ * INODE.
+ * Returns -1 if INODE does not contain data for a byte at offset
+ * POS. */
+static disk_sector_t
+byte_to_sector (struct inode *inode, off_t pos) {
+	return byte_to_run (inode, pos, NULL);
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes keyed by sector, so that opening a single inode twice
+ * returns the same `struct inode'.  OPEN_INODES_LOCK guards the table
+ * and every inode's open_cnt. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct inode *inode = hash_entry (e, struct inode, elem);
+	return hash_bytes (&inode->sector, sizeof inode->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+		< hash_entry (b, struct inode, elem)->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	hash_init (&open_inodes, inode_hash, inode_less, NULL);
+	lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -76,24 +173,24 @@ inode_create (disk_sector_t sector, off_t length) {
 	/* If this assertion fails, the inode structure is not exactly
 	 * one sector in size, and you should fix that. */
 	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
+	ASSERT (sizeof (struct extent_block) == DISK_SECTOR_SIZE);
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
-		disk_inode->length = length;
+		disk_inode->length = 0;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		journal_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
 		free (disk_inode);
+
+		/* Data sectors are allocated the same way a write at the end
+		 * of the file would. */
+		success = true;
+		if (length > 0) {
+			struct inode *inode = inode_open (sector);
+
+			success = inode != NULL && inode_grow (inode, length);
+			inode_close (inode);
+		}
 	}
 	return success;
 }
@@ -103,40 +200,54 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	struct inode key;  // hash 검색용 dummy inode
+	struct hash_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	/* Check whether this inode is already open.  The lock stays held
+	 * while a new inode is read, so that it is read only once. */
+	lock_acquire (&open_inodes_lock);
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
 	lock_init(&inode->filesys_lock);
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	lock_init (&inode->extent_lock);
+	cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	if (!inode_load_extents (inode)) {
+		free (inode);
+		inode = NULL;
+	} else
+		hash_insert (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -151,26 +262,220 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	bool last;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+	lock_acquire (&open_inodes_lock);
+	last = --inode->open_cnt == 0;
+	if (last)
+		hash_delete (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
 
+	if (last) {
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
+			journal_begin ();
+			inode_shrink (inode, 0);
 			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			journal_end ();
 		}
 
+		free (inode->extents);
+		free (inode->extent_end);
+		free (inode->blocks);
 		free (inode); 
 	}
 }
 
+/* Reads INODE's extent list, from its inode and indirect blocks, into
+ * memory.  Returns false if memory allocation fails. */
+static bool
+inode_load_extents (struct inode *inode) {
+	size_t cnt = inode->data.extent_cnt;
+	disk_sector_t next = inode->data.indirect;
+	size_t i;
+
+	inode->extent_cap = cnt > 0 ? cnt : 1;
+	inode->extents = malloc (inode->extent_cap * sizeof *inode->extents);
+	inode->extent_end = malloc (inode->extent_cap * sizeof *inode->extent_end);
+	inode->block_cnt = extents_to_blocks (cnt);
+	inode->blocks = malloc ((inode->block_cnt + 1) * sizeof *inode->blocks);
+	if (inode->extents == NULL || inode->extent_end == NULL
+			|| inode->blocks == NULL) {
+		free (inode->extents);
+		free (inode->extent_end);
+		free (inode->blocks);
+		return false;
+	}
+
+	for (i = 0; i < cnt && i < DIRECT_EXTENT_CNT; i++)
+		inode->extents[i] = inode->data.extents[i];
+	for (i = 0; i < inode->block_cnt; i++) {
+		size_t first = DIRECT_EXTENT_CNT + i * INDIRECT_EXTENT_CNT;
+		size_t n = cnt - first < INDIRECT_EXTENT_CNT
+			? cnt - first : INDIRECT_EXTENT_CNT;
+
+		inode->blocks[i] = next;
+		cache_read (next, inode->extents + first,
+				offsetof (struct extent_block, extents), n * sizeof (struct extent));
+		cache_read (next, &next, offsetof (struct extent_block, next),
+				sizeof next);
+	}
+
+	inode->sector_cnt = 0;
+	for (i = 0; i < cnt; i++) {
+		inode->sector_cnt += inode->extents[i].cnt;
+		inode->extent_end[i] = inode->sector_cnt;
+	}
+	return true;
+}
+
+/* Allocates data sectors for INODE to hold LENGTH bytes and extends
+ * its length to LENGTH.  New sectors are zeroed, and each new extent
+ * is placed just past the previous one when that space is free.
+ * Returns false, leaving INODE as it was, if the disk or memory runs
+ * out.  Call with INODE's extent_lock held, or before others can
+ * see INODE. */
+static bool
+inode_grow (struct inode *inode, off_t length) {
+	static char zeros[DISK_SECTOR_SIZE];
+	size_t old_cnt = inode->sector_cnt;
+	size_t old_extent_cnt = inode->data.extent_cnt;
+	size_t want = bytes_to_sectors (length);
+
+	while (inode->sector_cnt < want) {
+		size_t n = inode->data.extent_cnt;
+		disk_sector_t goal = n > 0
+			? inode->extents[n - 1].start + inode->extents[n - 1].cnt
+			: inode->sector + 1;
+		disk_sector_t start;
+		size_t got, i;
+
+		got = free_map_allocate_extent (want - inode->sector_cnt, goal, &start);
+		if (got == 0)
+			goto fail;
+		if (!inode_add_extent (inode, start, got)) {
+			free_map_release (start, got);
+			goto fail;
+		}
+		for (i = 0; i < got; i++)
+			cache_write (start + i, zeros, 0, DISK_SECTOR_SIZE);
+	}
+
+	if (length > inode->data.length)
+		inode->data.length = length;
+	inode_store (inode, old_extent_cnt > 0 ? old_extent_cnt - 1 : 0);
+	return true;
+
+fail:
+	inode_shrink (inode, old_cnt);
+	return false;
+}
+
+/* Releases INODE's data sectors past the first SECTOR_CNT, and the
+ * indirect blocks no longer needed.  Does not write INODE. */
+static void
+inode_shrink (struct inode *inode, size_t sector_cnt) {
+	size_t blocks;
+
+	while (inode->sector_cnt > sector_cnt) {
+		struct extent *e = &inode->extents[inode->data.extent_cnt - 1];
+		size_t drop = inode->sector_cnt - sector_cnt;
+
+		if (drop > e->cnt)
+			drop = e->cnt;
+		free_map_release (e->start + e->cnt - drop, drop);
+		e->cnt -= drop;
+		inode->sector_cnt -= drop;
+		inode->extent_end[inode->data.extent_cnt - 1] -= drop;
+		if (e->cnt == 0)
+			inode->data.extent_cnt--;
+	}
+
+	blocks = extents_to_blocks (inode->data.extent_cnt);
+	while (inode->block_cnt > blocks)
+		free_map_release (inode->blocks[--inode->block_cnt], 1);
+}
+
+/* Appends CNT sectors starting at START to INODE's extents, merging
+ * them into the last extent if they follow it on disk.  Allocates an
+ * indirect block if the extent needs one.  Returns false if memory or
+ * disk space runs out. */
+static bool
+inode_add_extent (struct inode *inode, disk_sector_t start, size_t cnt) {
+	size_t n = inode->data.extent_cnt;
+
+	if (n > 0 && inode->extents[n - 1].start + inode->extents[n - 1].cnt == start) {
+		inode->extents[n - 1].cnt += cnt;
+	} else {
+		if (n == inode->extent_cap) {
+			size_t cap = inode->extent_cap * 2;
+			struct extent *extents;
+			size_t *extent_end;
+
+			extents = realloc (inode->extents, cap * sizeof *extents);
+			if (extents == NULL)
+				return false;
+			inode->extents = extents;
+			extent_end = realloc (inode->extent_end, cap * sizeof *extent_end);
+			if (extent_end == NULL)
+				return false;
+			inode->extent_end = extent_end;
+			inode->extent_cap = cap;
+		}
+		if (extents_to_blocks (n + 1) > inode->block_cnt) {
+			disk_sector_t *blocks;
+			disk_sector_t block;
+
+			blocks = realloc (inode->blocks,
+					(inode->block_cnt + 1) * sizeof *blocks);
+			if (blocks == NULL)
+				return false;
+			inode->blocks = blocks;
+			if (!free_map_allocate (1, &block))
+				return false;
+			inode->blocks[inode->block_cnt++] = block;
+		}
+		inode->extents[n].start = start;
+		inode->extents[n].cnt = cnt;
+		inode->data.extent_cnt++;
+	}
+	inode->sector_cnt += cnt;
+	inode->extent_end[inode->data.extent_cnt - 1] = inode->sector_cnt;
+	return true;
+}
+
+/* Writes INODE to disk, along with the indirect blocks holding
+ * extents from FIRST_EXTENT on. */
+static void
+inode_store (struct inode *inode, size_t first_extent) {
+	size_t cnt = inode->data.extent_cnt;
+	size_t i;
+
+	for (i = 0; i < cnt && i < DIRECT_EXTENT_CNT; i++)
+		inode->data.extents[i] = inode->extents[i];
+	inode->data.indirect = inode->block_cnt > 0 ? inode->blocks[0] : 0;
+	journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+
+	for (i = 0; i < inode->block_cnt; i++) {
+		size_t first = DIRECT_EXTENT_CNT + i * INDIRECT_EXTENT_CNT;
+		size_t n = cnt - first < INDIRECT_EXTENT_CNT
+			? cnt - first : INDIRECT_EXTENT_CNT;
+		struct extent_block block;
+
+		if (first + INDIRECT_EXTENT_CNT <= first_extent)
+			continue;
+		memset (&block, 0, sizeof block);
+		block.next = i + 1 < inode->block_cnt ? inode->blocks[i + 1] : 0;
+		memcpy (block.extents, inode->extents + first, n * sizeof *block.extents);
+		journal_write (inode->blocks[i], &block, 0, DISK_SECTOR_SIZE);
+	}
+}
+
 /* Marks INODE to be deleted when it is closed by the last caller who
  * has it open. */
 void
@@ -183,14 +488,34 @@ inode_remove (struct inode *inode) {
  * Returns the number of bytes actually read, which may be less
  * than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) {
+	return inode_read (inode, buffer, size, offset, false);
+}
+
+/* Like inode_read_at(), but whole sectors that the buffer cache does
+ * not hold are read from disk straight into BUFFER, a run of them at
+ * a time, with no copy through the cache.  BUFFER must not page
+ * fault, since the disk is read with its channel locked: it must be
+ * kernel memory, or user memory pinned by vm_pin_buffer(). */
+off_t
+inode_read_at_direct (struct inode *inode, void *buffer, off_t size,
+		off_t offset) {
+	return inode_read (inode, buffer, size, offset, true);
+}
+
+/* Reads for inode_read_at() and, if DIRECT, inode_read_at_direct(). */
+static off_t
+inode_read (struct inode *inode, void *buffer_, off_t size, off_t offset,
+		bool direct) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
+	bool cached = false;
 
 	while (size > 0) {
-		/* Disk sector to read, starting byte offset within sector. */
-		disk_sector_t sector_idx = byte_to_sector (inode, offset);
+		/* Disk sector to read, sectors after it in the same extent,
+		 * starting byte offset within sector. */
+		size_t run_cnt, direct_cnt;
+		disk_sector_t sector_idx = byte_to_run (inode, offset, &run_cnt);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
 
 		/* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -203,46 +528,59 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+		/* Whole sectors are read around the cache if it lacks them,
+		 * as many at once as the extent and the request allow. */
+		direct_cnt = 0;
+		if (direct && chunk_size == DISK_SECTOR_SIZE) {
+			off_t left = size < inode_left ? size : inode_left;
+
+			direct_cnt = left / DISK_SECTOR_SIZE < (off_t) run_cnt
+				? (size_t) (left / DISK_SECTOR_SIZE) : run_cnt;
+			direct_cnt = cache_read_direct (sector_idx, direct_cnt,
+					buffer + bytes_read);
 		}
+		if (direct_cnt > 0)
+			chunk_size = direct_cnt * DISK_SECTOR_SIZE;
+		else
+			cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+		cached = direct_cnt == 0;
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+
+	/* Bring in the sector a sequential reader wants next, unless it
+	 * reads around the cache. */
+	if (cached && offset < inode_length (inode))
+		cache_read_ahead (byte_to_sector (inode, offset));
 
 	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if an error occurs.  A write past end of file
+ * extends the inode first; if the disk is full, only the bytes
+ * before end of file are written. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
 
+	if (size > 0 && offset + size > inode_length (inode)) {
+		journal_begin ();
+		lock_acquire (&inode->extent_lock);
+		inode_grow (inode, offset + size);
+		lock_release (&inode->extent_lock);
+		journal_end ();
+	}
+
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -258,34 +596,16 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* A partial write reads the rest of the sector into the
+		 * cache first.  Only directories and the free map are written
+		 * inside a journal handle, so only their blocks are logged. */
+		journal_write (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_written;
 }
@@ -0,0 +1,401 @@
+/* journal.c: Write-ahead journal for file system metadata.
+ *
+ * Code that changes metadata brackets the change with journal_begin()
+ * and journal_end(), and writes metadata sectors with journal_write().
+ * Inside such a handle, those writes are recorded in the running
+ * transaction and held in the buffer cache, so that none reaches its
+ * home location before the transaction is committed.  Handles nest,
+ * and all handles open at once join the same transaction.
+ *
+ * A transaction is committed, in one journal flush, once no handle is
+ * open and it has grown past JOURNAL_GROUP_BLOCKS, every
+ * JOURNAL_INTERVAL ticks, or at shutdown, so that many creates and
+ * removes share a commit.  Committing writes a descriptor, a copy of
+ * each sector and a commit record to the journal region, and then
+ * lets the cache write the sectors home as usual.  When the rest of
+ * the region cannot take the transaction, every sector committed
+ * before it is written home first (a checkpoint) and the log starts
+ * over; the transaction's own sectors stay held in the cache.
+ *
+ * The running transaction's sectors are held in the buffer cache
+ * until it commits, so JOURNAL_TX_BLOCKS is kept to half the cache.
+ * Each outermost handle reserves JOURNAL_HANDLE_BLOCKS sectors of the
+ * transaction, and the free map's chunks are reserved for the commit,
+ * so journal_begin() commits first when the reservations would not
+ * fit.  A handle that needs more than it reserved takes what room is
+ * left; if there is none, the transaction is committed early with the
+ * handles still open.  That keeps the transaction within its bound and
+ * every sector logged, at the cost of possibly making part of an
+ * operation durable before the rest.
+ *
+ * At boot, journal_open() replays every transaction whose commit
+ * record made it to disk.  File data is not journaled. */
+
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define JOURNAL_MAGIC 0x4a524e4c        /* "JRNL" */
+#define JOURNAL_DESC_MAGIC 0x4a444553   /* "JDES" */
+#define JOURNAL_COMMIT_MAGIC 0x4a434d54 /* "JCMT" */
+
+#define LOG_START (JOURNAL_SECTOR + 1)  /* First sector of the log. */
+#define LOG_END (JOURNAL_SECTOR + JOURNAL_SECTORS)
+
+#define JOURNAL_DESC_SLOTS 125      /* Sectors a descriptor can name. */
+#define JOURNAL_TX_BLOCKS (CACHE_SIZE / 2)  /* Most sectors in a transaction. */
+#define JOURNAL_HANDLE_BLOCKS 8     /* Sectors reserved by each handle. */
+#define JOURNAL_GROUP_BLOCKS 16     /* Commit before new handles past this. */
+#define JOURNAL_INTERVAL TIMER_FREQ /* Ticks between periodic commits. */
+
+/* Journal superblock, in sector JOURNAL_SECTOR.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_super {
+	uint32_t magic;                 /* JOURNAL_MAGIC. */
+	uint32_t seq;                   /* Transaction expected at LOG_START. */
+	uint32_t unused[126];
+};
+
+/* Descriptor that starts a transaction in the log, followed by a copy
+ * of each sector it names and then a commit record.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_desc {
+	uint32_t magic;                 /* JOURNAL_DESC_MAGIC. */
+	uint32_t seq;                   /* Transaction sequence number. */
+	uint32_t cnt;                   /* Number of sectors. */
+	disk_sector_t sectors[JOURNAL_DESC_SLOTS]; /* Home of each sector. */
+};
+
+/* Commit record that ends a transaction.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_commit {
+	uint32_t magic;                 /* JOURNAL_COMMIT_MAGIC. */
+	uint32_t seq;                   /* Transaction sequence number. */
+	uint32_t unused[126];
+};
+
+static bool enabled;                /* Journal opened. */
+static struct lock journal_lock;
+static struct condition journal_cond;   /* Handles drained or commit done. */
+static int handle_cnt;              /* Open outermost handles. */
+static size_t reserved;             /* Sectors reserved by open handles
+                                       and not yet written. */
+static bool committing;             /* A commit waits for handles to end. */
+
+/* Running transaction. */
+static uint32_t seq;
+static disk_sector_t tx_sectors[JOURNAL_TX_BLOCKS];
+static size_t tx_cnt;
+static disk_sector_t log_pos;       /* Where the next transaction goes. */
+
+static uint8_t journal_buf[DISK_SECTOR_SIZE];  /* Under journal_lock. */
+
+/* Statistics. */
+static long long handle_total, commit_cnt, block_cnt, checkpoint_cnt;
+static long long early_cnt;
+
+static void journal_commit (void);
+static void write_tx (void);
+static bool journal_fits (void);
+static void reserve_block (struct thread *);
+static void checkpoint (void);
+static void write_super (void);
+static void journald (void *aux);
+
+/* Sets up an empty journal on a newly formatted disk. */
+void
+journal_create (void) {
+	seq = 1;
+	write_super ();
+}
+
+/* Replays the journal's committed transactions, then starts using
+ * it. */
+void
+journal_open (void) {
+	struct journal_super *super = (struct journal_super *) journal_buf;
+	struct journal_desc *desc = (struct journal_desc *) journal_buf;
+	struct journal_commit *commit = (struct journal_commit *) journal_buf;
+	size_t replayed = 0;
+
+	ASSERT (sizeof *super == DISK_SECTOR_SIZE);
+	ASSERT (sizeof *desc == DISK_SECTOR_SIZE);
+	ASSERT (sizeof *commit == DISK_SECTOR_SIZE);
+	ASSERT (JOURNAL_TX_BLOCKS <= JOURNAL_DESC_SLOTS);
+
+	lock_init (&journal_lock);
+	cond_init (&journal_cond);
+
+	disk_read (filesys_disk, JOURNAL_SECTOR, super);
+	if (super->magic != JOURNAL_MAGIC)
+		PANIC ("file system has no journal");
+	seq = super->seq;
+
+	for (log_pos = LOG_START; log_pos + 1 < LOG_END; ) {
+		disk_sector_t sectors[JOURNAL_DESC_SLOTS];
+		size_t cnt, i;
+
+		disk_read (filesys_disk, log_pos, desc);
+		if (desc->magic != JOURNAL_DESC_MAGIC || desc->seq != seq
+				|| desc->cnt > JOURNAL_DESC_SLOTS
+				|| log_pos + desc->cnt + 2 > LOG_END)
+			break;
+		cnt = desc->cnt;
+		memcpy (sectors, desc->sectors, cnt * sizeof *sectors);
+
+		disk_read (filesys_disk, log_pos + cnt + 1, commit);
+		if (commit->magic != JOURNAL_COMMIT_MAGIC || commit->seq != seq)
+			break;
+
+		for (i = 0; i < cnt; i++) {
+			disk_read (filesys_disk, log_pos + 1 + i, journal_buf);
+			cache_write (sectors[i], journal_buf, 0, DISK_SECTOR_SIZE);
+		}
+		log_pos += cnt + 2;
+		seq++;
+		replayed++;
+	}
+	if (replayed > 0)
+		printf ("journal: replayed %zu transactions\n", replayed);
+
+	/* Start over with an empty log. */
+	cache_flush ();
+	write_super ();
+	log_pos = LOG_START;
+	enabled = true;
+	thread_create ("journald", PRI_DEFAULT, journald, NULL);
+}
+
+/* Commits the running transaction and empties the journal. */
+void
+journal_close (void) {
+	if (!enabled)
+		return;
+	lock_acquire (&journal_lock);
+	journal_commit ();
+	cache_flush ();
+	write_super ();
+	log_pos = LOG_START;
+	lock_release (&journal_lock);
+}
+
+/* Opens a handle on the running transaction.  Metadata written with
+ * journal_write() until the matching journal_end() belongs to it; it
+ * reserves JOURNAL_HANDLE_BLOCKS sectors.  Handles nest; only the
+ * outermost one may wait for a commit, so call it before taking file
+ * system locks. */
+void
+journal_begin (void) {
+	struct thread *t = thread_current ();
+
+	if (!enabled || t->journal_depth++ > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	for (;;) {
+		if (committing)
+			cond_wait (&journal_cond, &journal_lock);
+		else if (tx_cnt >= JOURNAL_GROUP_BLOCKS
+				|| (tx_cnt + handle_cnt > 0 && !journal_fits ()))
+			journal_commit ();
+		else
+			break;
+	}
+	handle_cnt++;
+	handle_total++;
+	reserved += JOURNAL_HANDLE_BLOCKS;
+	t->journal_left = JOURNAL_HANDLE_BLOCKS;
+	lock_release (&journal_lock);
+}
+
+/* Closes a handle opened by journal_begin().  The transaction is
+ * committed later, together with others. */
+void
+journal_end (void) {
+	struct thread *t = thread_current ();
+
+	if (!enabled)
+		return;
+	ASSERT (t->journal_depth > 0);
+	if (--t->journal_depth > 0)
+		return;
+
+	lock_acquire (&journal_lock);
+	reserved -= t->journal_left;
+	t->journal_left = 0;
+	if (--handle_cnt == 0)
+		cond_broadcast (&journal_cond, &journal_lock);
+	lock_release (&journal_lock);
+}
+
+/* Writes SIZE bytes from BUFFER to offset OFS of metadata SECTOR.
+ * Inside a handle the sector joins the running transaction;
+ * otherwise this is cache_write().  The buffer is written with
+ * journal_lock held, so that an early commit sees either all of the
+ * write or none of it. */
+void
+journal_write (disk_sector_t sector, const void *buffer, size_t ofs,
+		size_t size) {
+	struct thread *t = thread_current ();
+	size_t i;
+
+	if (enabled && t->journal_depth > 0) {
+		/* journal_commit() writes the free map with the lock held. */
+		bool held = lock_held_by_current_thread (&journal_lock);
+
+		if (!held)
+			lock_acquire (&journal_lock);
+		for (i = 0; i < tx_cnt; i++)
+			if (tx_sectors[i] == sector)
+				break;
+		if (i == tx_cnt) {
+			if (!held)
+				reserve_block (t);
+			ASSERT (tx_cnt < JOURNAL_TX_BLOCKS);
+			tx_sectors[tx_cnt++] = sector;
+		}
+		cache_write_logged (sector, buffer, ofs, size);
+		if (!held)
+			lock_release (&journal_lock);
+		return;
+	}
+	cache_write (sector, buffer, ofs, size);
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void) {
+	if (enabled)
+		printf ("Journal: %lld transactions in %lld commits (%lld early), "
+				"%lld sectors logged, %lld checkpoints\n",
+				handle_total, commit_cnt, early_cnt, block_cnt, checkpoint_cnt);
+}
+
+/* Waits for the open handles to end, then commits the running
+ * transaction.  Call with journal_lock held. */
+static void
+journal_commit (void) {
+	if (committing) {
+		while (committing)
+			cond_wait (&journal_cond, &journal_lock);
+		return;
+	}
+	committing = true;
+	while (handle_cnt > 0)
+		cond_wait (&journal_cond, &journal_lock);
+	write_tx ();
+	committing = false;
+	cond_broadcast (&journal_cond, &journal_lock);
+}
+
+/* Adds the free map's dirty chunks to the running transaction, writes
+ * it to the log and releases its sectors to the cache.  Never gives up
+ * journal_lock, which must be held, so no handle writes meanwhile. */
+static void
+write_tx (void) {
+	struct journal_desc *desc = (struct journal_desc *) journal_buf;
+	struct journal_commit *commit = (struct journal_commit *) journal_buf;
+	size_t i;
+
+	/* The free map writes its changes only now, as part of the
+	 * transaction that made them. */
+	thread_current ()->journal_depth++;
+	if (!free_map_sync ())
+		printf ("journal: free map write failed, retrying at next commit\n");
+	thread_current ()->journal_depth--;
+
+	if (tx_cnt > 0) {
+		if (log_pos + tx_cnt + 2 > LOG_END)
+			checkpoint ();
+		memset (desc, 0, sizeof *desc);
+		desc->magic = JOURNAL_DESC_MAGIC;
+		desc->seq = seq;
+		desc->cnt = tx_cnt;
+		memcpy (desc->sectors, tx_sectors, tx_cnt * sizeof *tx_sectors);
+		disk_write (filesys_disk, log_pos, desc);
+		for (i = 0; i < tx_cnt; i++) {
+			cache_read (tx_sectors[i], journal_buf, 0, DISK_SECTOR_SIZE);
+			disk_write (filesys_disk, log_pos + 1 + i, journal_buf);
+		}
+		memset (commit, 0, sizeof *commit);
+		commit->magic = JOURNAL_COMMIT_MAGIC;
+		commit->seq = seq;
+		disk_write (filesys_disk, log_pos + tx_cnt + 1, commit);
+
+		for (i = 0; i < tx_cnt; i++)
+			cache_unhold (tx_sectors[i]);
+		log_pos += tx_cnt + 2;
+		block_cnt += tx_cnt;
+		commit_cnt++;
+		seq++;
+		tx_cnt = 0;
+	}
+}
+
+/* Returns true if the running transaction has room for the sectors
+ * reserved by its handles, one more handle, and the free map.  Call
+ * with journal_lock held. */
+static bool
+journal_fits (void) {
+	return tx_cnt + reserved + JOURNAL_HANDLE_BLOCKS
+		+ free_map_chunk_cnt () <= JOURNAL_TX_BLOCKS;
+}
+
+/* Makes room in the running transaction for one more sector written by
+ * T's handle: out of the handle's reservation while it lasts, then out
+ * of the room nobody has reserved, and once that is gone too by
+ * committing the transaction early.  Call with journal_lock held. */
+static void
+reserve_block (struct thread *t) {
+	if (t->journal_left > 0) {
+		t->journal_left--;
+		reserved--;
+	} else if (tx_cnt + reserved + 1 + free_map_chunk_cnt ()
+			> JOURNAL_TX_BLOCKS) {
+		early_cnt++;
+		write_tx ();
+	}
+}
+
+/* Writes every committed sector home and starts the log over.  The
+ * running transaction's sectors are held, so they stay in the cache.
+ * Call with journal_lock held. */
+static void
+checkpoint (void) {
+	cache_flush ();
+	write_super ();
+	log_pos = LOG_START;
+	checkpoint_cnt++;
+}
+
+/* Writes the superblock, naming SEQ as the transaction at
+ * LOG_START. */
+static void
+write_super (void) {
+	struct journal_super *super = (struct journal_super *) journal_buf;
+
+	memset (super, 0, sizeof *super);
+	super->magic = JOURNAL_MAGIC;
+	super->seq = seq;
+	disk_write (filesys_disk, JOURNAL_SECTOR, super);
+}
+
+/* Commits the running transaction every JOURNAL_INTERVAL ticks. */
+static void
+journald (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (JOURNAL_INTERVAL);
+		lock_acquire (&journal_lock);
+		if (tx_cnt > 0)
+			journal_commit ();
+		lock_release (&journal_lock);
+	}
+}
@@ -0,0 +1,19 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/disk.h"
+
+#define CACHE_SIZE 64           /* Buffers. */
+
+void cache_init (void);
+void cache_read (disk_sector_t, void *, size_t ofs, size_t size);
+size_t cache_read_direct (disk_sector_t, size_t cnt, void *);
+void cache_write (disk_sector_t, const void *, size_t ofs, size_t size);
+void cache_write_logged (disk_sector_t, const void *, size_t ofs, size_t size);
+void cache_unhold (disk_sector_t);
+void cache_read_ahead (disk_sector_t);
+void cache_flush (void);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -35,4 +35,27 @@ cluster_t fat_get (cluster_t clst);
 void fat_put (cluster_t clst, cluster_t val);
 disk_sector_t cluster_to_sector (cluster_t clst);
 
+/* A contiguous run of clusters within a chain. */
+struct fat_run {
+	size_t ofs;             /* Index of the run's first cluster in the chain. */
+	cluster_t clst;         /* First cluster of the run. */
+	size_t cnt;             /* Number of clusters. */
+};
+
+/* Cache of the runs making up a chain, so that finding the Nth
+ * cluster of a file does not walk the chain from its start.  An inode
+ * whose data lives in a FAT chain keeps one beside its start cluster
+ * and maps byte offset POS with fat_chain_lookup (POS / DISK_SECTOR_SIZE)
+ * and cluster_to_sector(). */
+struct fat_chain {
+	cluster_t start;        /* First cluster, or 0 for an empty chain. */
+	struct fat_run *runs;   /* Runs read so far, in chain order. */
+	size_t run_cnt;
+	size_t run_cap;
+};
+
+void fat_chain_init (struct fat_chain *, cluster_t start);
+void fat_chain_destroy (struct fat_chain *);
+cluster_t fat_chain_lookup (struct fat_chain *, size_t idx);
+
 #endif /* filesys/fat.h */
@@ -0,0 +1,16 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+void journal_create (void);
+void journal_open (void);
+void journal_close (void);
+void journal_begin (void);
+void journal_end (void);
+void journal_write (disk_sector_t, const void *, size_t ofs, size_t size);
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
@@ -36,6 +36,14 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MSYNC,                  /* Write back a memory mapping. */
+	SYS_MADVISE,                /* Advise on the use of memory. */
+	SYS_MLOCK,                  /* Lock pages in memory. */
+	SYS_MUNLOCK,                /* Unlock pages. */
+	SYS_MLOCKALL,               /* Lock all pages in memory. */
+	SYS_MUNLOCKALL,             /* Unlock all pages. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -13,6 +13,26 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
 
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access. */
+#define MADV_WILLNEED 3         /* Will be needed soon. */
+#define MADV_DONTNEED 4         /* Not needed any more. */
+#define MADV_FREE 8             /* Contents not needed any more. */
+
+/* Flags for mlockall(). */
+#define MCL_CURRENT 1           /* Lock the pages mapped now. */
+#define MCL_FUTURE 2            /* Lock the pages mapped later. */
+
+/* Page fault classes, for get_fault_stats(). */
+#define FAULT_STACK 0           /* Stack growth. */
+#define FAULT_LAZY_FILE 1       /* File data read in. */
+#define FAULT_LAZY_ANON 2       /* Zero-filled page. */
+#define FAULT_SWAP_IN 3         /* Anonymous page back from swap. */
+#define FAULT_WRITE_PROTECT 4   /* Copy-on-write. */
+#define FAULT_INVALID 5         /* Not resolved. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -41,6 +61,12 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length);
+int madvise (void *addr, size_t length, int advice);
+int mlock (const void *addr, size_t length);
+int munlock (const void *addr, size_t length);
+int mlockall (int flags);
+int munlockall (void);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -78,4 +104,44 @@ get_fs_disk_write_cnt (void) {
 	return write_cnt;
 }
 
+static inline long long
+get_page_fault_cnt (void) {
+	long long fault_cnt;
+	asm volatile ("int $0x45" : "=a" (fault_cnt) : : "rdx");
+	return fault_cnt;
+}
+
+static inline long long
+get_evict_cnt (void) {
+	long long evict_cnt;
+	asm volatile ("int $0x45" : "=d" (evict_cnt) : : "rax");
+	return evict_cnt;
+}
+
+/* Returns the number of page faults of class CLS so far, and stores
+   the cycles spent on them in *CYCLES and the part of those spent
+   waiting on the disk in *DISK_CYCLES. */
+static inline long long
+get_fault_stats (int cls, long long *cycles, long long *disk_cycles) {
+	long long cnt, total, disk;
+	asm volatile ("int $0x46"
+			: "=a" (cnt), "=d" (total), "=c" (disk)
+			: "a" ((long long) cls), "d" (-1LL));
+	*cycles = total;
+	*disk_cycles = disk;
+	return cnt;
+}
+
+/* Returns the number of page faults of class CLS that took between
+   2^BUCKET and 2^(BUCKET+1) cycles. */
+static inline long long
+get_fault_hist (int cls, int bucket) {
+	long long cnt;
+	asm volatile ("int $0x46"
+			: "=a" (cnt)
+			: "a" ((long long) cls), "d" ((long long) bucket)
+			: "rcx");
+	return cnt;
+}
+
 #endif /* lib/user/syscall.h */
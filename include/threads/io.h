@@ -158,4 +158,13 @@ outsl (uint16_t port, const void *addr, size_t cnt) {
 			: "cc");
 }
 
+/* Returns the processor's time-stamp counter. */
+static inline uint64_t
+rdtsc (void) {
+	/* See [IA32-v2b] "RDTSC". */
+	uint32_t lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return (uint64_t) hi << 32 | lo;
+}
+
 #endif /* threads/io.h */
@@ -118,6 +118,9 @@ struct thread {
 
   int nice; 					/* 다른 스레드에게 얼마나 CPU time을 퍼줄 것인지 */
   fixed_point recent_cpu; 		/* 스레드가 CPU time을 얼마나 점유하고 있는지 */
+  uint64_t disk_cycles;			/* disk 요청에 걸린 TSC cycle 합 (disk.c) */
+  int journal_depth;			/* 열려 있는 journal handle 중첩 수 (journal.c) */
+  int journal_left;			/* journal handle이 예약하고 아직 안 쓴 sector 수 */
 #ifdef USERPROG
   /* Owned by userprog/process.c. */
   int exit_status; 				/* exit 했는지 확인하기 위한 status */
@@ -137,7 +140,17 @@ struct thread {
   struct supplemental_page_table spt;
   void *stack_bottom;
   void *rsp_stack;
-  struct list head_list;
+
+  /* Working set, sampled by vm.c. */
+  size_t rss;                   /* Pages of this process in frames. */
+  size_t ws_cnt;                /* Recently referenced pages, as of... */
+  unsigned ws_epoch;            /* ...this working-set sample. */
+  int pff_faults;               /* Page faults in sample interval... */
+  unsigned pff_epoch;           /* ...this one. */
+  int pff;                      /* Page faults in the interval before. */
+  size_t mlock_cnt;             /* Pages locked by mlock(). */
+  bool mlock_future;            /* mlockall(MCL_FUTURE) is in effect. */
+  void *cache_bounce;           /* file_cache_read/write의 bounce page. */
 #endif
 
   /* Owned by thread.c. */
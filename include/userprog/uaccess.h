@@ -0,0 +1,20 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/interrupt.h"
+
+/* Returned when a user address is bad. */
+#define EFAULT 14
+
+/* Kernel access to user memory.  A fault on a bad user address does
+ * not kill the kernel: the page fault handler resumes the copy at its
+ * fixup address, and the copy reports the failure to the caller. */
+size_t copy_from_user (void *dst, const void *usrc, size_t size);
+size_t copy_to_user (void *udst, const void *src, size_t size);
+long strncpy_from_user (char *dst, const char *usrc, size_t size);
+
+bool uaccess_fixup (struct intr_frame *f);
+
+#endif /* userprog/uaccess.h */
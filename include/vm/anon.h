@@ -2,13 +2,24 @@
 #define VM_ANON_H
 #include "vm/vm.h"
 struct page;
+struct frame;
 enum vm_type;
 
+struct zswap_entry;
+
 struct anon_page {
   int swap_index;
+  struct zswap_entry *zswap;   /* Compressed copy while swapped out. */
+  bool lazy_free;              /* Contents given up by MADV_FREE. */
 };
 
+/* Most pages written by one swap-out or read by one swap-in. */
+#define SWAP_CLUSTER 8
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+bool anon_swap_out_cluster (struct page **pages, size_t cnt);
+bool anon_swap_out_shared (struct frame *frame);
+void anon_discard (struct page *page);
 
 #endif
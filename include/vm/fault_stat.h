@@ -0,0 +1,26 @@
+#ifndef VM_FAULT_STAT_H
+#define VM_FAULT_STAT_H
+#include <stdint.h>
+
+/* Kinds of page fault, as classified by vm_try_handle_fault().  The
+ * values are those of the FAULT_* constants in lib/user/syscall.h. */
+enum fault_class {
+	FAULT_STACK = 0,            /* Stack growth. */
+	FAULT_LAZY_FILE = 1,        /* First touch, or re-read, of file data. */
+	FAULT_LAZY_ANON = 2,        /* First touch of a zero-filled page. */
+	FAULT_SWAP_IN = 3,          /* Anonymous page back from swap. */
+	FAULT_WRITE_PROTECT = 4,    /* Write to a copy-on-write page. */
+	FAULT_INVALID = 5,          /* Not resolved: the process dies. */
+	FAULT_CLASS_CNT
+};
+
+/* Latency histogram buckets: bucket N counts faults that took
+ * [2^N, 2^(N+1)) cycles. */
+#define FAULT_BUCKET_CNT 64
+
+void fault_stat_init (void);
+void fault_stat_record (enum fault_class cls, uint64_t cycles,
+		uint64_t disk_cycles);
+void fault_stat_print (void);
+
+#endif
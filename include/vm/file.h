@@ -12,12 +12,16 @@ struct file_page {
 	off_t ofs;
 	uint32_t read_bytes;
 	uint32_t zero_bytes;
-	bool header;
 };
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+bool f_lazy_load_segment (struct page *page, void *aux);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+bool do_msync (void *addr, size_t length);
+off_t file_cache_read (struct file *file, void *buffer, off_t size,
+		bool direct);
+off_t file_cache_write (struct file *file, const void *buffer, off_t size);
 #endif
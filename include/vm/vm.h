@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <hash.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -36,8 +37,27 @@ struct page_operations;
 struct thread;
 
 #define VM_TYPE(type) ((type) & 7)
+/* Marks read-only program text, whose frames are shared by every
+ * process running the same executable (see vm_claim_text()). */
+#define VM_TEXT VM_MARKER_1
 #define NOT_ACCESSED 0
 
+/* Advice given to an area by madvise().  The values are those of the
+ * MADV_* constants in lib/user/syscall.h. */
+enum vm_advice {
+	ADV_NORMAL = 0,         /* No special treatment. */
+	ADV_RANDOM = 1,         /* Expect random access: no read-around. */
+	ADV_SEQUENTIAL = 2,     /* Expect sequential access. */
+	ADV_WILLNEED = 3,       /* Will be needed soon: prefetch. */
+	ADV_DONTNEED = 4,       /* Not needed: drop the pages now. */
+	ADV_FREE = 8,           /* Contents not needed: drop them lazily. */
+};
+
+/* Flags for mlockall().  The values are those of the MCL_* constants
+ * in lib/user/syscall.h. */
+#define MLOCK_CURRENT 1         /* Lock the pages mapped now. */
+#define MLOCK_FUTURE 2          /* Lock the pages mapped from now on. */
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -49,8 +69,14 @@ struct page {
 
 	/* Your implementation */
 	bool writable;
+	struct thread *owner;          /* Thread whose pml4 maps this page. */
 	struct hash_elem h_elem;
-	struct list_elem head_elem;
+	struct list_elem frame_elem;   /* Element in frame's page list. */
+	bool clock_test;               /* Evicted during its test period. */
+	struct list_elem test_elem;    /* Element in the clock's test list. */
+	unsigned ws_epoch;             /* Last sample that saw it referenced. */
+	bool merged;                   /* Mapped to its frame by ksmd. */
+	bool locked;                   /* Locked in memory by mlock(). */
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union {
@@ -68,6 +94,22 @@ struct frame {
 	void *kva;
 	struct page *page;
 	struct list_elem f_elem;
+	struct list pages;      /* Pages mapping this frame (copy-on-write). */
+	int ref_cnt;            /* Number of pages in PAGES. */
+	bool hot;               /* Reused within a short interval. */
+	bool test;              /* Cold frame in its test period. */
+	bool evicting;          /* Being written out by vm_evict_frames(). */
+	bool pinned;            /* Being filled; must not be evicted. */
+	int mlock_cnt;          /* Locked pages in PAGES; never evicted. */
+	bool referenced;        /* Accessed bit taken by a working-set sample. */
+	bool drop;              /* Passed by a sequential scan: evict first. */
+	struct inode *inode;    /* File whose data the frame caches, or NULL. */
+	off_t ofs;              /* Offset of that data in INODE. */
+	size_t read_bytes;      /* Bytes of file data; the rest is zero. */
+	struct hash_elem cache_elem;  /* Element in the frame cache. */
+	bool ksm;               /* In ksmd's table. */
+	uint64_t ksm_sum;       /* Checksum when ksmd last saw the frame. */
+	struct hash_elem ksm_elem;    /* Element in ksmd's table. */
 };
 
 struct lazy_load_info{
@@ -78,6 +120,25 @@ struct lazy_load_info{
     bool writable;
 };
 
+/* A contiguous range of user virtual memory backed the same way, such
+ * as one ELF segment or one mmap.  Pages inside an area get their own
+ * struct page only when first touched, so mapping a large region costs
+ * a single area no matter how many pages it spans. */
+struct vm_area {
+	void *start;              /* First page of the area. */
+	void *end;                /* One past the last page. */
+	enum vm_type type;        /* Type given to pages created in the area. */
+	bool writable;
+	struct file *file;        /* Backing file, or NULL. */
+	off_t ofs;                /* File offset of START. */
+	size_t read_bytes;        /* Bytes read from FILE; the rest is zeroed. */
+	vm_initializer *init;     /* Lazy loader for pages of the area. */
+	void *next_fault;         /* Where a sequential fault would land next. */
+	size_t fault_around;      /* Pages mapped ahead of the next fault. */
+	enum vm_advice advice;    /* Access pattern given by madvise(). */
+	void *drop_cursor;        /* Pages below were marked to drop behind. */
+};
+
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
  * Put the table of "method" into the struct's member, and
@@ -98,7 +159,13 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-  struct hash spt_hash;
+  struct hash spt_hash;         /* Pages touched so far, keyed by va. */
+  struct vm_area **areas;       /* Areas sorted by start address. */
+  size_t area_cnt;              /* Number of areas in AREAS. */
+  size_t area_cap;              /* Allocated length of AREAS. */
+  struct lock lock;             /* Held by the owner while it changes the
+                                   table, and by prefetchd while it fills
+                                   pages for the owner. */
 };
 
 #include "threads/thread.h"
@@ -110,8 +177,18 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+struct page *spt_get_page (struct supplemental_page_table *spt, void *va);
+struct vm_area *spt_find_area (struct supplemental_page_table *spt,
+		void *va);
+bool spt_range_free (struct supplemental_page_table *spt, void *start,
+		void *end);
+void spt_remove_area (struct supplemental_page_table *spt,
+		struct vm_area *area);
+
+extern unsigned ksm_scan_pages;
 
 void vm_init (void);
+void ksm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -120,7 +197,23 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
+bool vm_alloc_area (enum vm_type type, void *start, size_t length,
+		bool writable, struct file *file, off_t ofs, size_t read_bytes,
+		vm_initializer *init);
 bool vm_claim_page (void *va);
+void vm_release_frame (struct page *page);
+void vm_admit (void);
+bool do_madvise (void *addr, size_t length, int advice);
+bool do_mlock (void *addr, size_t length);
+bool do_munlock (void *addr, size_t length);
+bool do_mlockall (int flags);
+void do_munlockall (void);
+bool vm_pin_buffer (void *addr, size_t length);
+void vm_unpin_buffer (void *addr, size_t length);
+bool vm_frame_clean (struct page *page, void *dst);
+bool vm_cache_read (struct inode *inode, off_t ofs, void *dst, size_t size);
+void vm_cache_write (struct inode *inode, off_t ofs, const void *src,
+		size_t size);
 enum vm_type page_get_type (struct page *page);
 
 bool install_page(void *upage, void *kpage, bool writable);
@@ -0,0 +1,16 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+
+struct page;
+struct zswap_entry;
+
+void zswap_init (void);
+struct zswap_entry *zswap_store (const void *kva, struct page *page);
+bool zswap_load (struct zswap_entry *entry, void *kva);
+void zswap_free (struct zswap_entry *entry);
+struct page *zswap_writeback (void *kva);
+bool zswap_over_budget (void);
+void zswap_print_stats (void);
+
+#endif
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'x'}{"file$_"} = [''] foreach grep ($_ % 10 == 0, 0...1999);
+check_archive ($fs);
+pass;
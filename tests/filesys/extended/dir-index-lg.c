@@ -0,0 +1,67 @@
+/* Creates enough files in one directory that its hash index has to
+   split leaves and then grow past what fits in a single index
+   block, checks that every file can be opened and listed, then
+   removes all but every tenth file. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 2000
+
+void
+test_main (void) 
+{
+  char name[READDIR_MAX_LEN + 1];
+  char file_name[32];
+  int fd, cnt, i;
+
+  CHECK (mkdir ("/x"), "mkdir \"/x\"");
+
+  msg ("creating /x/file0 through /x/file%d...", FILE_CNT - 1);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "/x/file%d", i);
+      CHECK (create (file_name, 0), "create \"%s\"", file_name);
+    }
+  quiet = false;
+
+  msg ("opening each file...");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "/x/file%d", i);
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      close (fd);
+    }
+  quiet = false;
+
+  CHECK ((fd = open ("/x")) > 1, "open \"/x\"");
+  for (cnt = 0; readdir (fd, name); cnt++)
+    continue;
+  close (fd);
+  if (cnt != FILE_CNT)
+    fail ("readdir returned %d entries, expected %d", cnt, FILE_CNT);
+  msg ("readdir \"/x\" returned %d entries", cnt);
+
+  msg ("removing all but every tenth file...");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    if (i % 10 != 0)
+      {
+        snprintf (file_name, sizeof file_name, "/x/file%d", i);
+        CHECK (remove (file_name), "remove \"%s\"", file_name);
+      }
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "/x/file%d", i);
+      fd = open (file_name);
+      if ((fd > 1) != (i % 10 == 0))
+        fail ("open \"%s\" returned %d after removals", file_name, fd);
+      if (fd > 1)
+        close (fd);
+    }
+  quiet = false;
+}
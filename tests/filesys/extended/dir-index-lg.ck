@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-index-lg) begin
+(dir-index-lg) mkdir "/x"
+(dir-index-lg) creating /x/file0 through /x/file1999...
+(dir-index-lg) opening each file...
+(dir-index-lg) open "/x"
+(dir-index-lg) readdir "/x" returned 2000 entries
+(dir-index-lg) removing all but every tenth file...
+(dir-index-lg) end
+EOF
+pass;
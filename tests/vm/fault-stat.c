@@ -0,0 +1,79 @@
+/* Takes page faults of several classes and checks that the fault
+   latency statistics count each of them, with a histogram that
+   adds up to the count. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char zeros[PAGE_SIZE * 4];
+
+static long long before[FAULT_INVALID + 1];
+
+static void
+save_counts (void)
+{
+  long long cycles, disk;
+  int cls;
+
+  for (cls = 0; cls <= FAULT_INVALID; cls++)
+    before[cls] = get_fault_stats (cls, &cycles, &disk);
+}
+
+static void
+check_class (int cls, const char *name)
+{
+  long long cycles, disk, cnt, sum = 0;
+  int i;
+
+  cnt = get_fault_stats (cls, &cycles, &disk);
+  if (cnt <= before[cls])
+    fail ("no %s faults counted", name);
+  if (cycles <= 0 || disk < 0 || disk > cycles)
+    fail ("bad %s fault times: %lld cycles, %lld on disk", name, cycles, disk);
+  for (i = 0; i < 64; i++)
+    sum += get_fault_hist (cls, i);
+  if (sum != cnt)
+    fail ("%s histogram holds %lld faults, not %lld", name, sum, cnt);
+  msg ("%s faults counted", name);
+}
+
+static void
+grow_stack (void)
+{
+  volatile char stack_obj[PAGE_SIZE * 4];
+
+  memset ((char *) stack_obj, 1, sizeof stack_obj);
+}
+
+void
+test_main (void)
+{
+  char *anon = (char *) (((unsigned long) zeros + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+  char *actual = (char *) 0x10000000;
+  int handle;
+  void *map;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (actual, PAGE_SIZE, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+
+  save_counts ();
+  grow_stack ();
+  if (actual[0] == 0)
+    fail ("mapping of \"sample.txt\" is empty");
+  if (anon[0] != 0)
+    fail ("zero-filled page is not zero");
+  anon[0] = 'x';
+
+  check_class (FAULT_STACK, "stack growth");
+  check_class (FAULT_LAZY_FILE, "lazy file");
+  check_class (FAULT_LAZY_ANON, "lazy anon");
+  check_class (FAULT_WRITE_PROTECT, "write-protect");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-stat) begin
+(fault-stat) open "sample.txt"
+(fault-stat) mmap "sample.txt"
+(fault-stat) stack growth faults counted
+(fault-stat) lazy file faults counted
+(fault-stat) lazy anon faults counted
+(fault-stat) write-protect faults counted
+(fault-stat) end
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Fills two pages with the same bytes and waits for the same-page
+   merging daemon to map both to one frame, then writes one of them
+   and checks that the write is kept from the other. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char pages[PAGE_SIZE * 3];
+
+void
+test_main (void)
+{
+  char *a = (char *) (((unsigned long) pages + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+  char *b = a + PAGE_SIZE;
+  size_t i;
+  long spins;
+
+  for (i = 0; i < PAGE_SIZE; i++)
+    a[i] = b[i] = i % 251;
+  msg ("fill two pages");
+
+  for (spins = 0; get_phys_addr (a) != get_phys_addr (b); spins++)
+    if (spins > 1000000000L)
+      fail ("pages were never merged");
+  msg ("pages merged");
+
+  a[0] = 'a';
+  if (b[0] != 0)
+    fail ("write to one merged page reached the other");
+  if (get_phys_addr (a) == get_phys_addr (b))
+    fail ("written page still shares its frame");
+  for (i = 1; i < PAGE_SIZE; i++)
+    if (a[i] != b[i])
+      fail ("byte %zu differs after copy-on-write", i);
+  msg ("write split the pages");
+}
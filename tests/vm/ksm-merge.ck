@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ksm-merge) begin
+(ksm-merge) fill two pages
+(ksm-merge) pages merged
+(ksm-merge) write split the pages
+(ksm-merge) end
+EOF
+pass;
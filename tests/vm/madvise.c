@@ -0,0 +1,82 @@
+/* Gives madvise() advice on anonymous memory and on a file
+   mapping: DONTNEED drops the contents at once, FREE keeps them
+   until memory runs short or the page is written again, SEQUENTIAL
+   lets a scan of the mapping fault only a few times, and WILLNEED
+   reads in a mapping not touched yet. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+static char zeros[PAGE_SIZE * 3];
+static char buf[PAGE_SIZE];
+
+void
+test_main (void)
+{
+  char *anon = (char *) (((unsigned long) zeros + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+  char *actual = (char *) 0x10000000;
+  char *untouched = (char *) 0x20000000;
+  long long faults;
+  int handle;
+  void *map, *map2;
+  size_t i;
+
+  memset (anon, 'a', PAGE_SIZE);
+  CHECK (madvise (anon, PAGE_SIZE, MADV_DONTNEED) == 0, "madvise DONTNEED");
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (anon[i] != 0)
+      fail ("byte %zu is %d after DONTNEED, not 0", i, anon[i]);
+
+  memset (anon, 'f', PAGE_SIZE);
+  CHECK (madvise (anon, PAGE_SIZE, MADV_FREE) == 0, "madvise FREE");
+  anon[0] = 'g';
+  if (anon[0] != 'g' || anon[PAGE_SIZE - 1] != 'f')
+    fail ("page written after FREE lost its contents");
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((handle = open ("big")) > 1, "open \"big\"");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      memset (buf, (char) i, sizeof buf);
+      if (write (handle, buf, sizeof buf) != (int) sizeof buf)
+        fail ("write of page %zu failed", i);
+    }
+  CHECK ((map = mmap (actual, PAGE_CNT * PAGE_SIZE, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"big\"");
+  CHECK (madvise (map, PAGE_CNT * PAGE_SIZE, MADV_SEQUENTIAL) == 0,
+         "madvise SEQUENTIAL");
+
+  msg ("read mapping sequentially");
+  faults = get_page_fault_cnt ();
+  for (i = 0; i < PAGE_CNT; i++)
+    if (actual[i * PAGE_SIZE] != (char) i)
+      fail ("page %zu of mmap'd region has bad data", i);
+  faults = get_page_fault_cnt () - faults;
+  if (faults > PAGE_CNT / 16)
+    fail ("%lld faults for %d pages read in order", faults, PAGE_CNT);
+
+  CHECK (madvise (map, PAGE_CNT * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise DONTNEED on mapping");
+  if (actual[PAGE_SIZE * 5] != 5)
+    fail ("mapping has bad data after DONTNEED");
+  CHECK (madvise (actual + PAGE_CNT * PAGE_SIZE, PAGE_SIZE, MADV_WILLNEED) == -1,
+         "madvise past mapping fails");
+
+  CHECK ((map2 = mmap (untouched, PAGE_CNT * PAGE_SIZE, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"big\" again");
+  CHECK (madvise (map2, PAGE_CNT * PAGE_SIZE, MADV_WILLNEED) == 0,
+         "madvise WILLNEED on untouched mapping");
+  msg ("read prefetched mapping");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (untouched[i * PAGE_SIZE] != (char) i)
+      fail ("page %zu of prefetched mapping has bad data", i);
+
+  munmap (map2);
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise DONTNEED
+(madvise) madvise FREE
+(madvise) create "big"
+(madvise) open "big"
+(madvise) mmap "big"
+(madvise) madvise SEQUENTIAL
+(madvise) read mapping sequentially
+(madvise) madvise DONTNEED on mapping
+(madvise) madvise past mapping fails
+(madvise) mmap "big" again
+(madvise) madvise WILLNEED on untouched mapping
+(madvise) read prefetched mapping
+(madvise) end
+EOF
+pass;
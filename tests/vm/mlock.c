@@ -0,0 +1,49 @@
+/* Locks a buffer in memory, then writes a buffer larger than user
+   memory so that pages must be evicted, and checks that the locked
+   buffer is read and written without a single page fault.  Locking
+   more than the per-process limit must fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 16
+
+static char hot[PAGE_SIZE * HOT_PAGES];
+static char big[4 * 1024 * 1024];
+
+void
+test_main (void)
+{
+  long long faults;
+  size_t i;
+
+  CHECK (mlock (hot, sizeof hot) == 0, "mlock hot buffer");
+  msg ("fill hot buffer");
+  faults = get_page_fault_cnt ();
+  for (i = 0; i < sizeof hot; i++)
+    hot[i] = 'h';
+  if (get_page_fault_cnt () != faults)
+    fail ("writing the locked buffer faulted");
+
+  msg ("write big buffer");
+  for (i = 0; i < sizeof big; i += PAGE_SIZE)
+    big[i] = i / PAGE_SIZE;
+
+  msg ("read hot buffer");
+  faults = get_page_fault_cnt ();
+  for (i = 0; i < sizeof hot; i++)
+    if (hot[i] != 'h')
+      fail ("byte %zu of the locked buffer is %d", i, hot[i]);
+  if (get_page_fault_cnt () != faults)
+    fail ("%lld faults reading the locked buffer",
+          get_page_fault_cnt () - faults);
+
+  CHECK (mlock (big, sizeof big) == -1, "mlock past the limit fails");
+  CHECK (mlock ((void *) 0x10000000, PAGE_SIZE) == -1, "mlock unmapped fails");
+  CHECK (munlock (hot, sizeof hot) == 0, "munlock hot buffer");
+  CHECK (mlockall (MCL_CURRENT | MCL_FUTURE) == -1,
+         "mlockall past the limit fails");
+  CHECK (munlockall () == 0, "munlockall");
+}
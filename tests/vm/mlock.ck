@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock) begin
+(mlock) mlock hot buffer
+(mlock) fill hot buffer
+(mlock) write big buffer
+(mlock) read hot buffer
+(mlock) mlock past the limit fails
+(mlock) mlock unmapped fails
+(mlock) munlock hot buffer
+(mlock) mlockall past the limit fails
+(mlock) munlockall
+(mlock) end
+EOF
+pass;
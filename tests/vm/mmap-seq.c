@@ -0,0 +1,47 @@
+/* Maps a 256 kB file and reads it front to back, one byte per
+   page.  Fault-around should map the pages ahead of each fault in
+   ever larger windows, so the scan takes far fewer faults than it
+   touches pages. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+static char buf[PAGE_SIZE];
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  long long faults;
+  int handle;
+  void *map;
+  size_t i;
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((handle = open ("big")) > 1, "open \"big\"");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      memset (buf, (char) i, sizeof buf);
+      if (write (handle, buf, sizeof buf) != (int) sizeof buf)
+        fail ("write of page %zu failed", i);
+    }
+  CHECK ((map = mmap (actual, PAGE_CNT * PAGE_SIZE, 0, handle, 0)) != MAP_FAILED,
+         "mmap \"big\"");
+
+  msg ("read mapping sequentially");
+  faults = get_page_fault_cnt ();
+  for (i = 0; i < PAGE_CNT; i++)
+    if (actual[i * PAGE_SIZE] != (char) i)
+      fail ("page %zu of mmap'd region has bad data", i);
+  faults = get_page_fault_cnt () - faults;
+  if (faults > PAGE_CNT / 4)
+    fail ("%lld faults for %d pages read in order", faults, PAGE_CNT);
+
+  munmap (map);
+  close (handle);
+}
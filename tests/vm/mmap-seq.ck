@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-seq) begin
+(mmap-seq) create "big"
+(mmap-seq) open "big"
+(mmap-seq) mmap "big"
+(mmap-seq) read mapping sequentially
+(mmap-seq) end
+EOF
+pass;
@@ -0,0 +1,68 @@
+/* Maps one file twice, writable, and checks that the two mappings,
+   a forked child's mapping, and the read and write system calls
+   all see the same data, then writes it back with msync. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 2
+
+static char buf[PAGE_SIZE * PAGE_CNT];
+
+void
+test_main (void)
+{
+  char *a = (char *) 0x10000000;
+  char *b = (char *) 0x20000000;
+  int handle[2];
+  pid_t child;
+
+  CHECK (create ("shared", sizeof buf), "create \"shared\"");
+  CHECK ((handle[0] = open ("shared")) > 1, "open \"shared\" #0");
+  CHECK ((handle[1] = open ("shared")) > 1, "open \"shared\" #1");
+  CHECK (mmap (a, sizeof buf, 1, handle[0], 0) != MAP_FAILED, "mmap \"shared\" #0");
+  CHECK (mmap (b, sizeof buf, 1, handle[1], 0) != MAP_FAILED, "mmap \"shared\" #1");
+
+  msg ("write through mapping #0");
+  memset (a, 'a', sizeof buf);
+  if (memcmp (a, b, sizeof buf))
+    fail ("mapping #1 does not see writes through mapping #0");
+
+  msg ("read before writeback");
+  CHECK (read (handle[1], buf, sizeof buf) == (int) sizeof buf, "read \"shared\"");
+  if (memcmp (buf, a, sizeof buf))
+    fail ("read does not see writes through the mapping");
+
+  msg ("write through fd");
+  memset (buf, 'w', PAGE_SIZE);
+  seek (handle[0], PAGE_SIZE / 2);
+  CHECK (write (handle[0], buf, PAGE_SIZE) == PAGE_SIZE, "write \"shared\"");
+  if (a[PAGE_SIZE / 2 - 1] != 'a' || a[PAGE_SIZE / 2] != 'w'
+      || b[PAGE_SIZE + PAGE_SIZE / 2 - 1] != 'w' || b[PAGE_SIZE + PAGE_SIZE / 2] != 'a')
+    fail ("mappings do not see data written through fd");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      a[100] = 'c';
+      exit (0);
+    }
+  quiet = true;
+  CHECK (wait (child) == 0, "wait for child");
+  quiet = false;
+  if (a[100] != 'c' || b[100] != 'c')
+    fail ("mappings do not see child's write");
+
+  CHECK (msync (a, sizeof buf) == 0, "msync mapping #0");
+  CHECK (msync (a + sizeof buf, PAGE_SIZE) == -1, "msync past mapping fails");
+  munmap (a);
+  munmap (b);
+
+  seek (handle[0], 0);
+  CHECK (read (handle[0], buf, sizeof buf) == (int) sizeof buf, "read \"shared\" back");
+  if (buf[100] != 'c' || buf[PAGE_SIZE / 2] != 'w' || buf[PAGE_SIZE * 2 - 1] != 'a')
+    fail ("file does not hold the mapped data");
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-shared) begin
+(mmap-shared) create "shared"
+(mmap-shared) open "shared" #0
+(mmap-shared) open "shared" #1
+(mmap-shared) mmap "shared" #0
+(mmap-shared) mmap "shared" #1
+(mmap-shared) write through mapping #0
+(mmap-shared) read before writeback
+(mmap-shared) read "shared"
+(mmap-shared) write through fd
+(mmap-shared) write "shared"
+(mmap-shared) msync mapping #0
+(mmap-shared) msync past mapping fails
+(mmap-shared) read "shared" back
+(mmap-shared) end
+EOF
+pass;
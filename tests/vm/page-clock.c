@@ -0,0 +1,51 @@
+/* Keeps a 1 MB hot working set busy while streaming once through a
+   24 MB cold region under memory pressure, then reports how often
+   the accesses faulted.  A scan-resistant replacement policy keeps
+   the hot set resident, so almost every fault comes from the scan. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 256                           /* Touched every round. */
+#define COLD_PAGES (24 * 256)                   /* Touched once each. */
+#define ROUNDS 48                               /* Number of rounds. */
+#define COLD_PER_ROUND (COLD_PAGES / ROUNDS)    /* Scan step per round. */
+
+static char hot[HOT_PAGES * PAGE_SIZE];
+static char cold[COLD_PAGES * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  long long faults, evictions, accesses;
+  size_t round, i;
+
+  msg ("initialize hot set");
+  for (i = 0; i < HOT_PAGES; i++)
+    hot[i * PAGE_SIZE] = (char) i;
+
+  msg ("scan cold region");
+  faults = get_page_fault_cnt ();
+  evictions = get_evict_cnt ();
+  for (round = 0; round < ROUNDS; round++)
+    {
+      for (i = 0; i < HOT_PAGES; i++)
+        if (hot[i * PAGE_SIZE]++ != (char) (i + round))
+          fail ("hot page %zu is inconsistent", i);
+      for (i = round * COLD_PER_ROUND; i < (round + 1) * COLD_PER_ROUND; i++)
+        cold[i * PAGE_SIZE] = (char) i;
+    }
+  faults = get_page_fault_cnt () - faults;
+  evictions = get_evict_cnt () - evictions;
+  accesses = (long long) ROUNDS * (HOT_PAGES + COLD_PER_ROUND);
+
+  msg ("fault rate: %lld faults, %lld evictions, %lld per 1000 accesses",
+       faults, evictions, faults * 1000 / accesses);
+
+  msg ("verify cold region");
+  for (i = 0; i < COLD_PAGES; i++)
+    if (cold[i * PAGE_SIZE] != (char) i)
+      fail ("cold page %zu is inconsistent", i);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "missing fault rate report\n"
+  if !grep (/^\(page-clock\) fault rate: \d+ faults, \d+ evictions, \d+ per 1000 accesses$/, @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1,
+		[grep (!/^\(page-clock\) fault rate: /, @output)], [<<'EOF']);
+(page-clock) begin
+(page-clock) initialize hot set
+(page-clock) scan cold region
+(page-clock) verify cold region
+(page-clock) end
+EOF
+pass;
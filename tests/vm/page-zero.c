@@ -0,0 +1,43 @@
+/* Reads through 16 MB of BSS, twice the memory given to the
+   machine, without writing to it.  Every page reads back as zero
+   and, since untouched anonymous pages share the zero page until
+   written, nothing has to be evicted.  Then writes a few pages and
+   checks that only those changed. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT (16 * 256)
+#define STRIDE 97
+
+static char big[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  long long evictions;
+  size_t i;
+
+  msg ("read untouched pages");
+  evictions = get_evict_cnt ();
+  for (i = 0; i < PAGE_CNT; i++)
+    if (big[i * PAGE_SIZE] != 0 || big[i * PAGE_SIZE + PAGE_SIZE - 1] != 0)
+      fail ("page %zu is not zeroed", i);
+  if (get_evict_cnt () != evictions)
+    fail ("reading zeroed pages caused %lld evictions",
+          get_evict_cnt () - evictions);
+
+  msg ("write some pages");
+  for (i = 0; i < PAGE_CNT; i += STRIDE)
+    big[i * PAGE_SIZE + 1] = (char) (i | 1);
+
+  msg ("verify");
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      char expected = i % STRIDE == 0 ? (char) (i | 1) : 0;
+      if (big[i * PAGE_SIZE] != 0 || big[i * PAGE_SIZE + 1] != expected)
+        fail ("page %zu has bad data", i);
+    }
+}
@@ -0,0 +1,90 @@
+/* Writes a 4 MB file, then reads it back whole with 512-byte,
+   4 kB and 64 kB read() calls, checking every byte and reporting
+   for each request size how many sectors came off the disk, how
+   many cycles the reads took per kB and a checksum of the data read.
+   Sector-aligned reads into a page-aligned buffer go straight from
+   disk into the buffer; the .ck file checks that they are no slower
+   than 512-byte reads and read the same data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (4 * 1024 * 1024)
+#define CHUNK_MAX (64 * 1024)
+
+static char buf[CHUNK_MAX] __attribute__ ((aligned (4096)));
+
+/* Returns the byte expected at offset OFS of the file. */
+static inline char
+expected (size_t ofs)
+{
+  return (char) (ofs * 7 + ofs / 4096);
+}
+
+static inline long long
+rdtsc (void)
+{
+  unsigned lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return (long long) hi << 32 | lo;
+}
+
+/* Reads the whole file at HANDLE with SIZE-byte requests. */
+static void
+read_file (int handle, size_t size)
+{
+  long long cycles = 0, sectors;
+  unsigned sum = 2166136261u;   /* FNV-1a of the bytes read. */
+  size_t ofs, i;
+
+  seek (handle, 0);
+  sectors = get_fs_disk_read_cnt ();
+  for (ofs = 0; ofs < FILE_SIZE; ofs += size)
+    {
+      long long start = rdtsc ();
+      int n = read (handle, buf, size);
+
+      cycles += rdtsc () - start;
+      if (n != (int) size)
+        fail ("read %d bytes at offset %zu, expected %zu", n, ofs, size);
+      for (i = 0; i < size; i++)
+        {
+          if (buf[i] != expected (ofs + i))
+            fail ("byte %zu differs with %zu-byte reads", ofs + i, size);
+          sum = (sum ^ (unsigned char) buf[i]) * 16777619u;
+        }
+    }
+  sectors = get_fs_disk_read_cnt () - sectors;
+
+  msg ("%zu-byte reads: %lld disk sectors, %lld cycles per kB, checksum %08x",
+       size, sectors, cycles / (FILE_SIZE / 1024), sum);
+}
+
+void
+test_main (void)
+{
+  int handle;
+  size_t ofs, i;
+
+  CHECK (create ("big", 0), "create \"big\"");
+  CHECK ((handle = open ("big")) > 1, "open \"big\"");
+
+  msg ("write 4 MB");
+  for (ofs = 0; ofs < FILE_SIZE; ofs += CHUNK_MAX)
+    {
+      for (i = 0; i < CHUNK_MAX; i++)
+        buf[i] = expected (ofs + i);
+      if (write (handle, buf, CHUNK_MAX) != CHUNK_MAX)
+        fail ("write at offset %zu failed", ofs);
+    }
+
+  read_file (handle, 512);
+  read_file (handle, 4096);
+  read_file (handle, CHUNK_MAX);
+
+  msg ("close \"big\"");
+  close (handle);
+}
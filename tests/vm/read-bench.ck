@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my (%cycles, %sum);
+foreach my $size (512, 4096, 65536) {
+  my ($line) = grep (/^\(read-bench\) $size-byte reads: /, @output);
+  fail "missing report for $size-byte reads\n" if !defined $line;
+  my ($cycles, $sum) = $line =~ /: \d+ disk sectors, (\d+) cycles per kB, checksum ([0-9a-f]{8})$/
+    or fail "malformed report for $size-byte reads: $line\n";
+  ($cycles{$size}, $sum{$size}) = ($cycles, $sum);
+}
+foreach my $size (4096, 65536) {
+  fail "$size-byte reads read checksum $sum{$size}, "
+    . "512-byte reads $sum{512}\n"
+    if $sum{$size} ne $sum{512};
+  fail "$size-byte reads took $cycles{$size} cycles per kB, "
+    . "more than the $cycles{512} of 512-byte reads\n"
+    if $cycles{$size} > $cycles{512};
+}
+compare_output ("run", IGNORE_EXIT_CODES => 1,
+		[grep (!/^\(read-bench\) \d+-byte reads: /, @output)], [<<'EOF']);
+(read-bench) begin
+(read-bench) create "big"
+(read-bench) open "big"
+(read-bench) write 4 MB
+(read-bench) close "big"
+(read-bench) end
+EOF
+pass;
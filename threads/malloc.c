@@ -32,7 +32,16 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   When malloc_trace is set (kernel option -mtrace), every block
+   also remembers the allocation site that obtained it: the
+   return address of the malloc() caller together with its size
+   class.  Arenas then reserve one byte per block at the end of
+   the page for the site index, so they hold slightly fewer
+   blocks.  Big blocks keep the site index in their arena header.
+   malloc_print_stats() reports the sites holding the most live
+   memory along with per-descriptor arena occupancy. */
 
 /* Descriptor. */
 struct desc {
@@ -40,6 +49,8 @@ struct desc {
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	size_t arena_cnt;           /* Number of arenas in use. */
+	size_t free_cnt;            /* Free blocks across those arenas. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -48,6 +59,7 @@ struct desc {
 /* Arena. */
 struct arena {
 	unsigned magic;             /* Always set to ARENA_MAGIC. */
+	uint8_t site;               /* Allocation site of a big block. */
 	struct desc *desc;          /* Owning descriptor, null for big block. */
 	size_t free_cnt;            /* Free blocks; pages in big block. */
 };
@@ -61,6 +73,37 @@ struct block {
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Allocation site, tracked only if malloc_trace is set. */
+struct site {
+	const void *caller;         /* Return address in malloc()'s caller. */
+	struct desc *desc;          /* Size class, null for big blocks. */
+	size_t live_cnt;            /* Blocks currently allocated. */
+	size_t live_bytes;          /* Bytes currently held, rounded up. */
+	size_t total_cnt;           /* Blocks ever allocated. */
+	size_t total_req;           /* Bytes ever requested. */
+};
+
+/* Site 0 collects allocations once the table is full. */
+#define SITE_CNT 256
+#define SITE_NONE 0
+
+/* Number of sites listed by malloc_print_stats(). */
+#define SITE_REPORT_CNT 10
+
+/* If true, record the allocation site of every block. */
+bool malloc_trace;
+
+static struct site sites[SITE_CNT];
+static struct lock site_lock;
+static size_t big_page_cnt;     /* Pages held by big blocks.
+                                   Protected by site_lock. */
+
+static void *do_malloc (size_t, const void *caller);
+static uint8_t site_get (const void *caller, struct desc *);
+static void site_account (uint8_t site, size_t size, size_t bytes, bool big);
+static void site_release (uint8_t site, size_t bytes, bool big);
+static uint8_t *arena_sites (struct arena *);
+static size_t block_index (struct arena *, struct block *);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -73,16 +116,27 @@ malloc_init (void) {
 		struct desc *d = &descs[desc_cnt++];
 		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
 		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+		if (malloc_trace)
+			d->blocks_per_arena = (PGSIZE - sizeof (struct arena))
+				/ (block_size + sizeof (uint8_t));
+		else
+			d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
 		list_init (&d->free_list);
 		lock_init (&d->lock);
 	}
+	lock_init (&site_lock);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	return do_malloc (size, __builtin_return_address (0));
+}
+
+/* Does the work of malloc(), attributing the block to CALLER. */
+static void *
+do_malloc (size_t size, const void *caller) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
@@ -109,6 +163,11 @@ malloc (size_t size) {
 		a->magic = ARENA_MAGIC;
 		a->desc = NULL;
 		a->free_cnt = page_cnt;
+		a->site = SITE_NONE;
+		if (malloc_trace) {
+			a->site = site_get (caller, NULL);
+			site_account (a->site, size, page_cnt * PGSIZE, true);
+		}
 		return a + 1;
 	}
 
@@ -133,12 +192,20 @@ malloc (size_t size) {
 			struct block *b = arena_to_block (a, i);
 			list_push_back (&d->free_list, &b->free_elem);
 		}
+		d->arena_cnt++;
+		d->free_cnt += d->blocks_per_arena;
 	}
 
 	/* Get a block from free list and return it. */
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
 	a->free_cnt--;
+	d->free_cnt--;
+	if (malloc_trace) {
+		uint8_t site = site_get (caller, d);
+		arena_sites (a)[block_index (a, b)] = site;
+		site_account (site, size, d->block_size, false);
+	}
 	lock_release (&d->lock);
 	return b;
 }
@@ -156,7 +223,7 @@ calloc (size_t a, size_t b) {
 		return NULL;
 
 	/* Allocate and zero memory. */
-	p = malloc (size);
+	p = do_malloc (size, __builtin_return_address (0));
 	if (p != NULL)
 		memset (p, 0, size);
 
@@ -185,7 +252,7 @@ realloc (void *old_block, size_t new_size) {
 		free (old_block);
 		return NULL;
 	} else {
-		void *new_block = malloc (new_size);
+		void *new_block = do_malloc (new_size, __builtin_return_address (0));
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
 			size_t min_size = new_size < old_size ? new_size : old_size;
@@ -215,8 +282,13 @@ free (void *p) {
 
 			lock_acquire (&d->lock);
 
+			if (malloc_trace)
+				site_release (arena_sites (a)[block_index (a, b)], d->block_size,
+						false);
+
 			/* Add block to free list. */
 			list_push_front (&d->free_list, &b->free_elem);
+			d->free_cnt++;
 
 			/* If the arena is now entirely unused, free it. */
 			if (++a->free_cnt >= d->blocks_per_arena) {
@@ -228,11 +300,15 @@ free (void *p) {
 					list_remove (&b->free_elem);
 				}
 				palloc_free_page (a);
+				d->arena_cnt--;
+				d->free_cnt -= d->blocks_per_arena;
 			}
 
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
+			if (malloc_trace)
+				site_release (a->site, a->free_cnt * PGSIZE, true);
 			palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
@@ -266,3 +342,153 @@ arena_to_block (struct arena *a, size_t idx) {
 			+ sizeof *a
 			+ idx * a->desc->block_size);
 }
+
+/* Returns the site-index array kept at the end of arena A's
+   page.  Only meaningful if malloc_trace is set. */
+static uint8_t *
+arena_sites (struct arena *a) {
+	ASSERT (a->desc != NULL);
+	return (uint8_t *) a + PGSIZE - a->desc->blocks_per_arena;
+}
+
+/* Returns the index of block B within arena A. */
+static size_t
+block_index (struct arena *a, struct block *b) {
+	return (pg_ofs (b) - sizeof *a) / a->desc->block_size;
+}
+
+/* Returns the index of the site for allocations from CALLER in
+   size class D, creating the site if necessary.  Falls back to
+   SITE_NONE if the table is full. */
+static uint8_t
+site_get (const void *caller, struct desc *d) {
+	size_t start = ((uintptr_t) caller ^ (uintptr_t) d) % (SITE_CNT - 1);
+	size_t i;
+
+	lock_acquire (&site_lock);
+	for (i = 0; i < SITE_CNT - 1; i++) {
+		size_t idx = (start + i) % (SITE_CNT - 1) + 1;
+		struct site *s = &sites[idx];
+
+		if (s->caller == NULL) {
+			s->caller = caller;
+			s->desc = d;
+		}
+		if (s->caller == caller && s->desc == d) {
+			lock_release (&site_lock);
+			return idx;
+		}
+	}
+	lock_release (&site_lock);
+	return SITE_NONE;
+}
+
+/* Charges a new block of BYTES bytes, requested as SIZE bytes,
+   to SITE.  BIG is true if the block is a run of whole pages. */
+static void
+site_account (uint8_t site, size_t size, size_t bytes, bool big) {
+	struct site *s = &sites[site];
+
+	lock_acquire (&site_lock);
+	s->live_cnt++;
+	s->live_bytes += bytes;
+	s->total_cnt++;
+	s->total_req += size;
+	if (big)
+		big_page_cnt += bytes / PGSIZE;
+	lock_release (&site_lock);
+}
+
+/* Credits a freed block of BYTES bytes back to SITE.  BIG is as
+   for site_account(). */
+static void
+site_release (uint8_t site, size_t bytes, bool big) {
+	struct site *s = &sites[site];
+
+	lock_acquire (&site_lock);
+	ASSERT (s->live_cnt > 0);
+	s->live_cnt--;
+	s->live_bytes -= bytes;
+	if (big)
+		big_page_cnt -= bytes / PGSIZE;
+	lock_release (&site_lock);
+}
+
+/* Prints per-descriptor arena occupancy and, if malloc_trace is
+   set, the allocation sites holding the most live memory.  The
+   site addresses can be turned into function names and line
+   numbers with the `backtrace' utility. */
+void
+malloc_print_stats (void) {
+	uint8_t top[SITE_REPORT_CNT];
+	size_t top_cnt = 0;
+	size_t i, j;
+
+	printf ("Malloc: %8s %7s %8s %8s %9s\n",
+			"size", "arenas", "used", "free", "occupancy");
+	for (i = 0; i < desc_cnt; i++) {
+		struct desc *d = &descs[i];
+		size_t total, used;
+
+		lock_acquire (&d->lock);
+		total = d->arena_cnt * d->blocks_per_arena;
+		used = total - d->free_cnt;
+		lock_release (&d->lock);
+
+		if (total != 0)
+			printf ("        %8zu %7zu %8zu %8zu %8zu%%\n", d->block_size,
+					d->arena_cnt, used, total - used, used * 100 / total);
+	}
+
+	if (!malloc_trace)
+		return;
+
+	lock_acquire (&site_lock);
+	printf ("Malloc: %zu pages in big blocks\n", big_page_cnt);
+
+	/* Blocks charged to SITE_NONE come from many callers and size
+	   classes, so they are not ranked with the real sites. */
+	if (sites[SITE_NONE].live_cnt != 0)
+		printf ("Malloc: site table full, %zu blocks (%zu bytes) "
+				"from untracked sites\n",
+				sites[SITE_NONE].live_cnt, sites[SITE_NONE].live_bytes);
+
+	/* Select the sites with the most live bytes, largest first. */
+	for (i = SITE_NONE + 1; i < SITE_CNT; i++) {
+		if (sites[i].live_cnt == 0)
+			continue;
+		for (j = top_cnt; j > 0
+				&& sites[top[j - 1]].live_bytes < sites[i].live_bytes; j--)
+			if (j < SITE_REPORT_CNT)
+				top[j] = top[j - 1];
+		if (j < SITE_REPORT_CNT) {
+			top[j] = i;
+			if (top_cnt < SITE_REPORT_CNT)
+				top_cnt++;
+		}
+	}
+
+	printf ("Malloc: top %zu allocation sites by live bytes\n", top_cnt);
+	printf ("        %18s %6s %8s %10s %8s %6s\n",
+			"caller", "class", "live", "bytes", "total", "waste");
+	for (i = 0; i < top_cnt; i++) {
+		struct site *s = &sites[top[i]];
+		size_t class = s->desc != NULL ? s->desc->block_size : 0;
+		size_t avg_req = s->total_req / s->total_cnt;
+		size_t waste = class > avg_req ? (class - avg_req) * 100 / class : 0;
+
+		printf ("        %18p", s->caller);
+		if (class != 0)
+			printf (" %6zu", class);
+		else
+			printf (" %6s", "big");
+		printf (" %8zu %10zu %8zu %5zu%%\n",
+				s->live_cnt, s->live_bytes, s->total_cnt, waste);
+	}
+
+	printf ("Allocation sites:");
+	for (i = 0; i < top_cnt; i++)
+		printf (" %p", sites[top[i]].caller);
+	printf (".\n");
+	lock_release (&site_lock);
+}
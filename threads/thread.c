@@ -529,7 +529,6 @@ init_thread (struct thread *t, const char *name, int priority) {
   sema_init(&t->fork_sema, 0);
 #endif //USERPROG
 #ifdef VM
-  list_init(&t->head_list);
 #endif //VM
 }
 
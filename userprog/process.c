@@ -180,6 +180,7 @@ static void __do_fork(void *aux) {
 
 #ifdef VM
   supplemental_page_table_init(&current->spt);
+  current->stack_bottom = parent->stack_bottom;
   if (!supplemental_page_table_copy(&current->spt, &parent->spt))
     goto error;
 #else
@@ -244,6 +245,11 @@ int process_exec(void *f_name) {
   /* 현재 실행 중인 스레드의 컨텍스트 종료 */
   process_cleanup();
 
+#ifdef VM
+  /* 메모리가 다른 process들의 working set으로 차 있으면 잠시 기다림 */
+  vm_admit();
+#endif
+
   /* 이후에 바이너리 파일 로드 */
   success = load(argv[0], &_if);
   if (!success) {
@@ -301,7 +307,6 @@ void process_exit(void) {
     }
   }
   palloc_free_multiple(t->fd_table, FDT_PAGES);
-  file_close(t->running); // 실행중인 파일 닫기
 
   /* 부모가 가진 내 유서를 수정. { exit_status(사망 원인), exited(사망 여부) } */
   if (t->parent != NULL) {
@@ -323,10 +328,15 @@ void process_exit(void) {
     free(ch_info);
   }
 
+  process_cleanup();
+  /* 실행중인 파일 닫기.  Text frames are cached by the file's inode, so
+   * it stays open until process_cleanup() has released them, and it is
+   * closed before the parent wakes, which may then write to it. */
+  file_close(t->running);
+  t->running = NULL;
+
   /* 나의 죽음을 기다리던 부모가 있다면 깨우기 */
   sema_up(&t->wait_sema);
-
-  process_cleanup();
 }
 
 /* Free the current process's resources. */
@@ -334,8 +344,10 @@ static void process_cleanup(void) {
   struct thread *curr = thread_current();
 
 #ifdef VM
-  if(!hash_empty(&curr->spt.spt_hash))
+  if(!hash_empty(&curr->spt.spt_hash) || curr->spt.area_cnt > 0)
     supplemental_page_table_kill(&curr->spt);
+  palloc_free_page(curr->cache_bounce);
+  curr->cache_bounce = NULL;
 #endif
 
   uint64_t *pml4;
@@ -415,9 +427,9 @@ void argument_stack(int argc, char **argv, struct intr_frame *if_) {
 #define PT_PHDR 6           /* Program header table. */
 #define PT_STACK 0x6474e551 /* Stack segment. */
 
-#define PF_X 1 /* Executable. */
-#define PF_W 2 /* Writable. */
-#define PF_R 4 /* Readable. */
+#define PHDR_FLAG_X 1 /* Executable. */
+#define PHDR_FLAG_W 2 /* Writable. */
+#define PHDR_FLAG_R 4 /* Readable. */
 
 /* Executable header.  See [ELF1] 1-4 to 1-8.
  * This appears at the very beginning of an ELF binary. */
@@ -536,7 +548,7 @@ static bool load(const char *file_name, struct intr_frame *if_) {
       goto done;
     case PT_LOAD:
       if (validate_segment(&phdr, file)) {
-        bool writable = (phdr.p_flags & PF_W) != 0;
+        bool writable = (phdr.p_flags & PHDR_FLAG_W) != 0;
         uint64_t file_page = phdr.p_offset & ~PGMASK;
         uint64_t mem_page = phdr.p_vaddr & ~PGMASK;
         uint64_t page_offset = phdr.p_vaddr & PGMASK;
@@ -782,35 +794,12 @@ static bool load_segment(struct file *file, off_t ofs, uint8_t *upage, uint32_t
   ASSERT(pg_ofs(upage) == 0);
   ASSERT(ofs % PGSIZE == 0);
 
-  while (read_bytes > 0 || zero_bytes > 0) {
-    /* Do calculate how to fill this page.
-     * We will read PAGE_READ_BYTES bytes from FILE
-     * and zero the final PAGE_ZERO_BYTES bytes. */
-    size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-    size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-    /* TODO: Set up aux to pass information to the lazy_load_segment. */
-    struct lazy_load_info *aux = malloc(sizeof(struct lazy_load_info));
-    if (!aux) {
-      return false;
-    }
-
-    aux->file = file;
-    aux->ofs = ofs;
-    aux->read_bytes = page_read_bytes;
-    aux->zero_bytes = page_zero_bytes;
-    aux->writable = writable;
-
-    if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, aux)) {
-      return false;
-    }
-    /* Advance. */
-    read_bytes -= page_read_bytes;
-    zero_bytes -= page_zero_bytes;
-    upage += PGSIZE;
-    ofs += page_read_bytes;
-  }
-  return true;
+  /* The pages are created one at a time as they are faulted in.
+   * Read-only segments are program text: their frames are shared with
+   * every other process running the same file. */
+  if (!writable)
+    return vm_alloc_area(VM_FILE | VM_TEXT, upage, read_bytes + zero_bytes, false, file, ofs, read_bytes, f_lazy_load_segment);
+  return vm_alloc_area(VM_ANON, upage, read_bytes + zero_bytes, writable, file, ofs, read_bytes, lazy_load_segment);
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
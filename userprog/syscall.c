@@ -13,9 +13,11 @@
 #include "threads/loader.h"
 #include "threads/thread.h"
 #include "threads/init.h"
+#include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "userprog/gdt.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "filesys/inode.h"
@@ -35,8 +37,11 @@
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
 
 
+#ifdef VM
 struct page * check_address(void *addr);
+#endif
 void check_valid_buffer(void* buffer, unsigned size, bool to_write);
+static char *copy_in_string(const char *ustr);
 void syscall_entry(void);
 void syscall_handler(struct intr_frame *);
 
@@ -61,8 +66,16 @@ void delete_file_from_fd_table(int fd);
 
 int dup2(int oldfd, int newfd);
 
+#ifdef VM
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr); 
+int msync (void *addr, size_t length);
+int madvise (void *addr, size_t length, int advice);
+int mlock (const void *addr, size_t length);
+int munlock (const void *addr, size_t length);
+int mlockall (int flags);
+int munlockall (void);
+#endif
 
 /**
  * @brief 사용자 주소가 유효한지 여부를 판단한다. 두 가지 검사를 수행한다.
@@ -75,26 +88,82 @@ void munmap (void *addr);
  * @return 주소가 유효한지 여부
  * @note 해당 함수는 유저 프로그램을 종료시켜줍니다.
  */
+#ifdef VM
 struct page * check_address(void *addr){
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    struct page *page;
+
     if(is_kernel_vaddr(addr)){
         exit(-1);
     }
-    return spt_find_page(&thread_current()->spt,addr);
+    lock_acquire(&spt->lock);
+    page = spt_get_page(spt, addr);
+    lock_release(&spt->lock);
+    return page;
 }
+#endif
 
+/**
+ * @brief buffer가 걸쳐 있는 page마다 한 번씩만 검사한다. VM이 없으면
+ * page가 모두 올라와 있으므로 page table만 본다.
+ */
 void check_valid_buffer(void* buffer, unsigned size, bool to_write) {
-    for(int i = 0; i < size; i++){
-      struct page* page = check_address(buffer + i);
-      
+    if (size == 0) {
+      return;
+    }
+    void *last = pg_round_down(buffer + size - 1);
+    for (void *upage = pg_round_down(buffer); ; upage += PGSIZE) {
+#ifdef VM
+      struct page* page = check_address(upage < buffer ? buffer : upage);
+
       if (page == NULL) {
         exit(-1);
       } else {
         if (to_write == false && !page->writable)
           exit(-1);
       }
+#else
+      uint64_t *pte = is_user_vaddr(upage)
+          ? pml4e_walk(thread_current()->pml4, (uint64_t) upage, 0) : NULL;
+
+      if (pte == NULL || (*pte & PTE_P) == 0) {
+        exit(-1);
+      } else {
+        if (to_write == false && !is_writable(pte))
+          exit(-1);
+      }
+#endif
+      if (upage == last) {
+        break;
+      }
     }
 }
 
+/**
+ * @brief user 문자열을 새 kernel page로 복사한다. 잘못된 주소면 프로세스를
+ * 종료시키고, 한 page보다 길거나 page를 못 받으면 NULL을 반환한다.
+ *
+ * @note 반환된 page는 palloc_free_page()로 해제해야 한다.
+ */
+static char *copy_in_string(const char *ustr) {
+  char *kstr = palloc_get_page(0);
+  long len;
+
+  if (kstr == NULL) {
+    return NULL;
+  }
+  len = strncpy_from_user(kstr, ustr, PGSIZE);
+  if (len < 0) {
+    palloc_free_page(kstr);
+    exit(-1);
+  }
+  if (len == PGSIZE) {
+    palloc_free_page(kstr);
+    return NULL;
+  }
+  return kstr;
+}
+
 void syscall_init(void) {
   write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48 | ((uint64_t)SEL_KCSEG)
                                                                << 32);
@@ -159,12 +228,46 @@ void syscall_handler(struct intr_frame *f UNUSED) {
     case SYS_CLOSE:
       close(f->R.rdi);
       break;
+#ifdef VM
     case SYS_MMAP:
       f->R.rax = mmap(f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10, f->R.r8);
       break;
     case SYS_MUNMAP:
       munmap(f->R.rdi);
       break;
+    case SYS_MSYNC:
+      f->R.rax = msync((void *)f->R.rdi, f->R.rsi);
+      break;
+    case SYS_MADVISE:
+      f->R.rax = madvise((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+      break;
+    case SYS_MLOCK:
+      f->R.rax = mlock((const void *)f->R.rdi, f->R.rsi);
+      break;
+    case SYS_MUNLOCK:
+      f->R.rax = munlock((const void *)f->R.rdi, f->R.rsi);
+      break;
+    case SYS_MLOCKALL:
+      f->R.rax = mlockall(f->R.rdi);
+      break;
+    case SYS_MUNLOCKALL:
+      f->R.rax = munlockall();
+      break;
+#else
+    case SYS_MMAP:
+      f->R.rax = (uint64_t) MAP_FAILED;
+      break;
+    case SYS_MUNMAP:
+      break;
+    case SYS_MSYNC:
+    case SYS_MADVISE:
+    case SYS_MLOCK:
+    case SYS_MUNLOCK:
+    case SYS_MLOCKALL:
+    case SYS_MUNLOCKALL:
+      f->R.rax = -1;
+      break;
+#endif
     default:
       printf("system call!\n");
       thread_exit();
@@ -199,10 +302,15 @@ void exit(int status) {
  * @return pid_t negative if errr occured, else positive number
  */
 pid_t fork(const char *thread_name) {
-  if(check_address(thread_name) == NULL){
-      exit(-1);
+  char *name = copy_in_string(thread_name);
+  pid_t pid;
+
+  if (name == NULL) {
+    return TID_ERROR;
   }
-  return process_fork(thread_name, NULL);
+  pid = process_fork(name, NULL);
+  palloc_free_page(name);
+  return pid;
 }
 
 /**
@@ -211,15 +319,10 @@ pid_t fork(const char *thread_name) {
  * @return int 실행 성공(1)/실패(0) 여부를 반환한다.
  */
 int exec(const char *file) {
-  if(check_address(file) == NULL){
-      exit(-1);
-  }
-
-  uint8_t *page;
-  if((page = palloc_get_page(PAL_USER)) == NULL) {
+  char *page = copy_in_string(file);
+  if (page == NULL) {
     return -1;
   }
-  memcpy((void *)page, file, strlen(file) + 1);
 
   int success = process_exec((void *)page);
   // free page if unsuccesful
@@ -241,31 +344,42 @@ int wait(pid_t pid) {
  * @brief 파일을 생성하는 system call, 생성 성공 여부를 bool로 반환한다.
  */
 bool create(const char *file, unsigned initial_size) {
-  if(check_address(file) == NULL){
-      exit(-1);
+  char *name = copy_in_string(file);
+  bool success;
+
+  if (name == NULL) {
+    return false;
   }
-  return filesys_create(file, initial_size);
+  success = filesys_create(name, initial_size);
+  palloc_free_page(name);
+  return success;
 }
 
 /**
  * @brief 파일을 삭제하는 system call, 삭제 성공 여부를 bool로 반환한다.
  */
 bool remove(const char *file) {
-  if(check_address(file) == NULL){
-      exit(-1);
+  char *name = copy_in_string(file);
+  bool success;
+
+  if (name == NULL) {
+    return false;
   }
-  return filesys_remove(file);
+  success = filesys_remove(name);
+  palloc_free_page(name);
+  return success;
 }
 
 /**
  * @brief 파일을 여는 system call
  */
 int open(const char *file) {
-  if(check_address(file) == NULL){
-      exit(-1);
+  char *name = copy_in_string(file);
+  if (name == NULL) {
+    return -1;
   }
-  struct thread *t = thread_current();
-  struct file *file_obj = filesys_open(file);
+  struct file *file_obj = filesys_open(name);
+  palloc_free_page(name);
   if (file_obj == NULL) {
     return -1;
   }
@@ -328,12 +442,52 @@ struct file *fd_to_file(int fd) {
   return file;
 }
 
+#ifdef VM
+/* 한 번에 고정하는 buffer page 수 */
+#define READ_PIN_PAGES 16
+
+/**
+ * @brief buffer를 READ_PIN_PAGES page씩 고정해 가며 file을 읽는다. 고정된
+ * page에는 disk에서 바로 읽어 들여 kernel에서 복사하지 않는다. 고정하지
+ * 못한 부분은 buffer cache를 거쳐 복사한다. 읽은 byte 수를 반환
+ */
+static off_t read_pinned(struct file *file, void *buffer, unsigned size) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  uint8_t *buf = buffer;
+  off_t done = 0;
+
+  while (done < (off_t) size) {
+    off_t chunk = READ_PIN_PAGES * PGSIZE - pg_ofs(buf + done);
+    off_t n;
+    bool pinned;
+
+    if (chunk > (off_t) size - done) {
+      chunk = size - done;
+    }
+    lock_acquire(&spt->lock);
+    pinned = vm_pin_buffer(buf + done, chunk);
+    lock_release(&spt->lock);
+
+    n = file_cache_read(file, buf + done, chunk, pinned);
+
+    if (pinned) {
+      lock_acquire(&spt->lock);
+      vm_unpin_buffer(buf + done, chunk);
+      lock_release(&spt->lock);
+    }
+    done += n;
+    if (n < chunk) {
+      break;
+    }
+  }
+  return done;
+}
+#endif
+
 /**
  * @brief 파일을 읽는 system call, 읽은 byte 수를 반환
  */
 int read(int fd, void *buffer, unsigned size) {
-  check_valid_buffer(buffer, size, false);
-  
   uint8_t *buf = buffer;
   off_t read_count;
 
@@ -341,7 +495,9 @@ int read(int fd, void *buffer, unsigned size) {
     char key;
     for (read_count = 0; read_count < size; read_count++) {
       key = input_getc();
-      *buf++ = key;
+      if (copy_to_user(buf + read_count, &key, 1) != 0) {
+        return -EFAULT;
+      }
       if (key == '\0') {
         break;
       }
@@ -353,12 +509,18 @@ int read(int fd, void *buffer, unsigned size) {
     if (filep == NULL) { // 파일을 읽을 수 없는 경우
       return -1;
     }
+    // file은 lock을 잡은 채 buffer에 바로 쓰므로 미리 검사한다
+    check_valid_buffer(buffer, size, false);
     // exclusive read & write
     lock_acquire(inode_get_lock(file_get_inode(filep))); 
     // printf("lock 획득 성공\n");
     // printf("filep : %p\n", filep);
     // printf("buffer : %p\n", buffer);
-    read_count = file_read(filep, buffer, size);
+#ifdef VM
+    read_count = read_pinned(filep, buffer, size);  // mmap된 page는 frame에서
+#else
+    read_count = file_read_direct(filep, buffer, size);  // user page는 항상 메모리에 있음
+#endif
     // printf("file_read 성공\n");
     lock_release(inode_get_lock(file_get_inode(filep)));
     // printf("lock 해제 성공\n");
@@ -367,17 +529,40 @@ int read(int fd, void *buffer, unsigned size) {
   return read_count;
 }
 
+/**
+ * @brief user buffer를 한 page씩 kernel로 복사해 console에 출력한다.
+ * 출력한 byte 수를 반환하고, buffer 주소가 잘못되었으면 -EFAULT를 반환한다.
+ */
+static int write_console(const void *buffer, unsigned size) {
+  const uint8_t *buf = buffer;
+  char *kbuf = palloc_get_page(0);
+  unsigned done;
+
+  if (kbuf == NULL) {
+    return -1;
+  }
+  for (done = 0; done < size; ) {
+    unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+
+    if (copy_from_user(kbuf, buf + done, chunk) != 0) {
+      palloc_free_page(kbuf);
+      return -EFAULT;
+    }
+    putbuf(kbuf, chunk);
+    done += chunk;
+  }
+  palloc_free_page(kbuf);
+  return done;
+}
+
 /**
  * @brief 파일 내용을 작성하는 system call, 작성한 byte 수 반환
  */
 int write(int fd, const void *buffer, unsigned size) {
-  check_valid_buffer(buffer, size, true);
-
   int write_count;
 
   if (fd == STDOUT_FILENO) {
-    putbuf(buffer, size);
-    write_count = size;
+    write_count = write_console(buffer, size);
   } else if (fd == STDIN_FILENO) {
     return 0;
   } else {
@@ -385,10 +570,15 @@ int write(int fd, const void *buffer, unsigned size) {
     if (filep == NULL) {
       return 0;
     }
+    check_valid_buffer(buffer, size, true);
 
     // exclusive read & write
     lock_acquire(inode_get_lock(file_get_inode(filep)));
+#ifdef VM
+    write_count = file_cache_write(filep, buffer, size);
+#else
     write_count = file_write(filep, buffer, size);
+#endif
     lock_release(inode_get_lock(file_get_inode(filep)));
   }
   return write_count;
@@ -452,6 +642,7 @@ int dup2(int oldfd, int newfd) { return 0; }
 // !SECTION - Project 2 USERPROG SYSTEM CALL
 
 // SECTION - Project 3 VM SYSTEM CALL
+#ifdef VM
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
   if (offset % PGSIZE != 0) {
     return NULL;
@@ -467,10 +658,99 @@ void *mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
     return NULL;
   }
 
-  return do_mmap(addr, length, writable, file, offset);
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  void *mapping;
+
+  lock_acquire(&spt->lock);
+  mapping = do_mmap(addr, length, writable, file, offset);
+  lock_release(&spt->lock);
+  return mapping;
 }
 
 void munmap (void *addr) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+
+  lock_acquire(&spt->lock);
   do_munmap(addr);
+  lock_release(&spt->lock);
+}
+
+/**
+ * @brief mmap된 영역 중 수정된 page를 파일에 기록한다. 성공하면 0, 아니면 -1
+ */
+int msync (void *addr, size_t length) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  bool success;
+
+  lock_acquire(&spt->lock);
+  success = do_msync(addr, length);
+  lock_release(&spt->lock);
+  return success ? 0 : -1;
+}
+
+/**
+ * @brief 메모리 영역의 사용 방식을 알려준다. 성공하면 0, 아니면 -1
+ */
+int madvise (void *addr, size_t length, int advice) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  bool success;
+
+  lock_acquire(&spt->lock);
+  success = do_madvise(addr, length, advice);
+  lock_release(&spt->lock);
+  return success ? 0 : -1;
+}
+
+/**
+ * @brief 범위의 page들을 바로 불러와 메모리에 고정한다. 성공하면 0, 아니면 -1
+ */
+int mlock (const void *addr, size_t length) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  bool success;
+
+  lock_acquire(&spt->lock);
+  success = do_mlock((void *)addr, length);
+  lock_release(&spt->lock);
+  return success ? 0 : -1;
+}
+
+/**
+ * @brief 범위의 page들의 고정을 푼다. 성공하면 0, 아니면 -1
+ */
+int munlock (const void *addr, size_t length) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  bool success;
+
+  lock_acquire(&spt->lock);
+  success = do_munlock((void *)addr, length);
+  lock_release(&spt->lock);
+  return success ? 0 : -1;
+}
+
+/**
+ * @brief 지금(MCL_CURRENT) 또는 앞으로(MCL_FUTURE) 매핑되는 page를 모두
+ * 메모리에 고정한다. 성공하면 0, 아니면 -1
+ */
+int mlockall (int flags) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  bool success;
+
+  lock_acquire(&spt->lock);
+  success = do_mlockall(flags);
+  lock_release(&spt->lock);
+  return success ? 0 : -1;
+}
+
+/**
+ * @brief 모든 page의 고정을 푼다. 항상 0
+ */
+int munlockall (void) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+
+  lock_acquire(&spt->lock);
+  do_munlockall();
+  lock_release(&spt->lock);
+  return 0;
 }
+#endif
 // !SECTION - Project 3 VM SYSTEM CALL
\ No newline at end of file
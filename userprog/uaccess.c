@@ -0,0 +1,107 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* One entry of the exception table: an instruction that may fault on a
+ * user address and the address at which to resume if it does.  The
+ * table is collected by the linker between __ex_table_start and
+ * __ex_table_end (see kernel.lds.S). */
+struct exception_entry {
+	uint64_t insn;
+	uint64_t fixup;
+};
+
+extern const struct exception_entry __ex_table_start[], __ex_table_end[];
+
+/* Records that a fault at label INSN resumes at label FIXUP. */
+#define EX_TABLE(INSN, FIXUP)                 \
+	".pushsection __ex_table, \"a\"\n"        \
+	".balign 8\n"                             \
+	".quad " #INSN ", " #FIXUP "\n"           \
+	".popsection\n"
+
+/* Returns true if [UADDR, UADDR + SIZE) lies entirely in user space. */
+static bool
+range_ok (const void *uaddr, size_t size) {
+	uint64_t start = (uint64_t) uaddr;
+	return start + size >= start && start + size <= KERN_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST with a single string move.  If the
+ * move faults, RCX still holds the number of bytes left, which is what
+ * the fixup returns. */
+static size_t
+copy_bytes (void *dst, const void *src, size_t size) {
+	__asm __volatile (
+			"1: rep movsb\n"
+			"2:\n"
+			EX_TABLE (1b, 2b)
+			: "+c" (size), "+D" (dst), "+S" (src) : : "memory");
+	return size;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+ * Returns the number of bytes that could not be copied, so 0 means
+ * success. */
+size_t
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	if (!range_ok (usrc, size))
+		return size;
+	return copy_bytes (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+ * Returns the number of bytes that could not be copied, so 0 means
+ * success. */
+size_t
+copy_to_user (void *udst, const void *src, size_t size) {
+	if (!range_ok (udst, size))
+		return size;
+	return copy_bytes (udst, src, size);
+}
+
+/* Reads the byte at user address UADDR into *BYTE.  Returns 0 on
+ * success or -EFAULT if UADDR faulted. */
+static int
+get_user (const char *uaddr, char *byte) {
+	int error;
+	__asm __volatile (
+			"movl %3, %0\n"
+			"1: movb %2, %1\n"
+			"xorl %0, %0\n"
+			"2:\n"
+			EX_TABLE (1b, 2b)
+			: "=&r" (error), "=q" (*byte) : "m" (*uaddr), "i" (-EFAULT));
+	return error;
+}
+
+/* Copies the null-terminated user string USRC into DST, which holds
+ * SIZE bytes.  Returns the length of the string, or SIZE if no null
+ * terminator was found within SIZE bytes (DST is then not terminated),
+ * or -EFAULT if USRC is a bad address. */
+long
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (!is_user_vaddr (usrc + i) || get_user (usrc + i, &dst[i]) != 0)
+			return -EFAULT;
+		if (dst[i] == '\0')
+			return i;
+	}
+	return size;
+}
+
+/* If F faulted at an instruction listed in the exception table, points
+ * F at the instruction's fixup and returns true. */
+bool
+uaccess_fixup (struct intr_frame *f) {
+	const struct exception_entry *e;
+
+	for (e = __ex_table_start; e < __ex_table_end; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
@@ -1,9 +1,14 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include "threads/mmu.h"
 #include "devices/disk.h"
 #include "threads/vaddr.h"
 #include "bitmap.h"
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "vm/zswap.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -12,9 +17,38 @@ static bool anon_swap_out (struct page *page);
 static void anon_destroy (struct page *page);
 
 struct bitmap *swap_table;
+static unsigned *swap_refs;     /* Pages referring to each in-use slot. */
+static struct lock swap_lock;   /* Protects swap_table and the swap cache, and
+                                   serializes swap I/O against slot reuse. */
+static size_t swap_cursor;      /* Next-fit start for slot allocation. */
 
 #define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
 
+/* Swap cache.  A swap-in reads the slots that follow the faulting
+ * one in the same request and keeps them here, so faults on pages
+ * that were evicted together are served without another disk
+ * access.  Entries are dropped in FIFO order once the cache is full. */
+#define SWAP_CACHE_PAGES 32
+struct swap_cache_entry {
+	size_t slot;                /* Swap slot the contents came from. */
+	void *kva;                  /* Kernel page holding the contents. */
+	struct list_elem elem;      /* Element in swap_cache. */
+};
+static struct list swap_cache;
+static size_t swap_cache_cnt;
+
+/* Pages that pages leaving the compressed store are decompressed
+ * into on their way to disk.  Used under swap_lock. */
+static uint8_t *swap_bounce;
+
+static size_t swap_alloc (size_t cnt);
+static void swap_free (size_t slot);
+static struct swap_cache_entry *swap_cache_find (size_t slot);
+static void swap_cache_drop (struct swap_cache_entry *e);
+static void swap_read_ahead (size_t slot, void *kva);
+static bool swap_write (struct page **pages, size_t cnt);
+static void swap_shrink (void);
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -30,6 +64,14 @@ vm_anon_init (void) {
 	swap_disk = disk_get(1, 1);
 	int swap_table_size = disk_size(swap_disk) / SECTORS_PER_PAGE;
 	swap_table = bitmap_create(swap_table_size);
+	swap_refs = calloc(swap_table_size, sizeof *swap_refs);
+	if (swap_refs == NULL) {
+		PANIC ("vm_anon_init: no memory for swap slot counts");
+	}
+	lock_init(&swap_lock);
+	list_init(&swap_cache);
+	swap_bounce = palloc_get_multiple(PAL_ASSERT, SWAP_CLUSTER);
+	zswap_init();
 }
 
 /* Initialize the file mapping */
@@ -40,23 +82,47 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	
 	struct anon_page *anon_page = &page->anon;
 	anon_page->swap_index = -1;
+	anon_page->zswap = NULL;
+	anon_page->lazy_free = false;
+	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Swap in the page from the compressed store, the swap cache, or
+ * by reading its slot, and the slots after it, from the swap disk.
+ * A page whose contents were given up comes back zeroed. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
 	int swap_index = anon_page->swap_index;
+	struct swap_cache_entry *e;
 
-	if (bitmap_test(swap_table, swap_index) == false) {
-		return false;
+	if (anon_page->lazy_free) {
+		anon_page->lazy_free = false;
+		memset(kva, 0, PGSIZE);
+		return true;
 	}
 
-	for (int i = 0; i < SECTORS_PER_PAGE; ++i) {
-		disk_read(swap_disk, i + SECTORS_PER_PAGE * swap_index, kva + i * DISK_SECTOR_SIZE);
+	lock_acquire(&swap_lock);
+	if (zswap_load(anon_page->zswap, kva)) {
+		zswap_free(anon_page->zswap);
+		anon_page->zswap = NULL;
+		lock_release(&swap_lock);
+		return true;
+	}
+	if (swap_index == -1 || bitmap_test(swap_table, swap_index) == false) {
+		lock_release(&swap_lock);
+		return false;
 	}
 
-	bitmap_set(swap_table, anon_page->swap_index, false);
+	e = swap_cache_find(swap_index);
+	if (e != NULL) {
+		memcpy(kva, e->kva, PGSIZE);
+	} else {
+		swap_read_ahead(swap_index, kva);
+	}
+	swap_free(swap_index);
+	lock_release(&swap_lock);
+	anon_page->swap_index = -1;
 
 	return true;
 }
@@ -64,27 +130,297 @@ anon_swap_in (struct page *page, void *kva) {
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
-	int swap_index = bitmap_scan(swap_table, 0, 1, false);
-	if (swap_index == BITMAP_ERROR) {
-		return false;
-	}
+	return anon_swap_out_cluster(&page, 1);
+}
+
+/* Swaps out the CNT resident anonymous PAGES together.  Each is
+ * offered to the compressed store first; the rest get a run of
+ * adjacent slots and are written by a single disk request.  If that
+ * grows the store past its budget, its oldest pages are written back
+ * to disk.  Pages given up by MADV_FREE and not written since are
+ * dropped instead.  Returns false if the swap disk is full. */
+bool
+anon_swap_out_cluster (struct page **pages, size_t cnt) {
+	struct page *to_disk[SWAP_CLUSTER];
+	size_t disk_cnt = 0, i;
+	bool success = true;
+
+	ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+
+	lock_acquire(&swap_lock);
+	for (i = 0; i < cnt; i++) {
+		struct page *page = pages[i];
 
-	for(int i = 0; i < SECTORS_PER_PAGE; ++i) {
-		disk_write(swap_disk, i + SECTORS_PER_PAGE * swap_index, (page->va) + i * DISK_SECTOR_SIZE);
+		/* Unmap from the owner's page table before reading the frame,
+		 * so the owner cannot change the page behind our back: the
+		 * victim may belong to another process. */
+		pml4_clear_page(page->owner->pml4, page->va);
+		if (page->anon.lazy_free) {
+			if (!pml4_is_dirty(page->owner->pml4, page->va)) {
+				continue;
+			}
+			page->anon.lazy_free = false;
+		}
+		page->anon.zswap = zswap_store(page->frame->kva, page);
+		if (page->anon.zswap == NULL) {
+			to_disk[disk_cnt++] = page;
+		}
 	}
+	if (disk_cnt > 0) {
+		success = swap_write(to_disk, disk_cnt);
+	}
+	swap_shrink();
+	lock_release(&swap_lock);
+	return success;
+}
 
-	bitmap_set(swap_table, swap_index, true);
-	pml4_clear_page(thread_current()->pml4, page->va);
+/* Swaps out FRAME, an anonymous frame that several pages share, once:
+ * every page is unmapped, the frame is written to one swap slot, and
+ * each page keeps a reference to that slot.  Shared frames bypass the
+ * compressed store, whose entries belong to a single page.  Pages
+ * given up by MADV_FREE keep their contents, as they may.  Returns
+ * false if the swap disk is full. */
+bool
+anon_swap_out_shared (struct frame *frame) {
+	struct disk_iov iov;
+	struct list_elem *e;
+	size_t slot;
 
-	anon_page->swap_index = swap_index;
+	lock_acquire(&swap_lock);
+	for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e)) {
+		struct page *page = list_entry(e, struct page, frame_elem);
+
+		pml4_clear_page(page->owner->pml4, page->va);
+		page->anon.lazy_free = false;
+	}
+	slot = swap_alloc(1);
+	if (slot == BITMAP_ERROR) {
+		lock_release(&swap_lock);
+		return false;
+	}
+	swap_refs[slot] = frame->ref_cnt;
+	for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e)) {
+		list_entry(e, struct page, frame_elem)->anon.swap_index = slot;
+	}
+	iov.buffer = frame->kva;
+	iov.sector_cnt = SECTORS_PER_PAGE;
+	disk_writev(swap_disk, slot * SECTORS_PER_PAGE, &iov, 1);
+	lock_release(&swap_lock);
 	return true;
 }
+
+/* Gives up the contents of PAGE, which is swapped out: its copy in
+ * the compressed store or on the swap disk is freed, and the page
+ * comes back zeroed. */
+void
+anon_discard (struct page *page) {
+	struct anon_page *anon_page = &page->anon;
+
+	lock_acquire(&swap_lock);
+	if (anon_page->zswap != NULL) {
+		zswap_free(anon_page->zswap);
+		anon_page->zswap = NULL;
+	} else if (anon_page->swap_index != -1) {
+		swap_free(anon_page->swap_index);
+		anon_page->swap_index = -1;
+	}
+	lock_release(&swap_lock);
+	anon_page->lazy_free = true;
+}
+
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
 
-	pml4_clear_page(thread_current()->pml4, page->va);
+	vm_release_frame(page);
+	if (anon_page->swap_index != -1 || anon_page->zswap != NULL) {
+		lock_acquire(&swap_lock);
+		if (anon_page->zswap != NULL) {
+			zswap_free(anon_page->zswap);
+		} else {
+			swap_free(anon_page->swap_index);
+		}
+		lock_release(&swap_lock);
+	}
+}
+
+/* Writes the CNT resident PAGES, already unmapped, to a run of
+ * adjacent swap slots with one disk request, or one page at a time
+ * when no run of CNT free slots is left.  Returns false if the swap
+ * disk is full.  Call with swap_lock held. */
+static bool
+swap_write (struct page **pages, size_t cnt) {
+	struct disk_iov iov[SWAP_CLUSTER];
+	size_t slot, i;
+
+	slot = swap_alloc(cnt);
+	if (slot == BITMAP_ERROR) {
+		if (cnt == 1) {
+			return false;
+		}
+		for (i = 0; i < cnt; i++) {
+			if (!swap_write(&pages[i], 1)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		iov[i].buffer = pages[i]->frame->kva;
+		iov[i].sector_cnt = SECTORS_PER_PAGE;
+		pages[i]->anon.swap_index = slot + i;
+	}
+	disk_writev(swap_disk, slot * SECTORS_PER_PAGE, iov, cnt);
+	return true;
+}
+
+/* Moves the oldest pages of the compressed store on to the swap
+ * disk, SWAP_CLUSTER at a time, until the store is back within its
+ * budget or the disk is full.  Call with swap_lock held. */
+static void
+swap_shrink (void) {
+	struct disk_iov iov[SWAP_CLUSTER];
+
+	while (zswap_over_budget()) {
+		size_t cnt = SWAP_CLUSTER, slot, i;
+
+		slot = swap_alloc(cnt);
+		if (slot == BITMAP_ERROR) {
+			cnt = 1;
+			slot = swap_alloc(cnt);
+			if (slot == BITMAP_ERROR) {
+				return;
+			}
+		}
+		for (i = 0; i < cnt; i++) {
+			void *buffer = swap_bounce + i * PGSIZE;
+			struct page *page = zswap_writeback(buffer);
+
+			if (page == NULL) {
+				break;
+			}
+			page->anon.zswap = NULL;
+			page->anon.swap_index = slot + i;
+			iov[i].buffer = buffer;
+			iov[i].sector_cnt = SECTORS_PER_PAGE;
+		}
+		for (size_t j = i; j < cnt; j++) {
+			swap_free(slot + j);
+		}
+		if (i > 0) {
+			disk_writev(swap_disk, slot * SECTORS_PER_PAGE, iov, i);
+		}
+	}
+}
+
+/* Allocates a run of CNT adjacent free swap slots and returns the
+ * first, or BITMAP_ERROR.  The search resumes where the last one
+ * ended rather than at slot 0, so successive evictions are laid out
+ * one after another.  Call with swap_lock held. */
+static size_t
+swap_alloc (size_t cnt) {
+	size_t slot = bitmap_scan_and_flip(swap_table, swap_cursor, cnt, false);
+
+	if (slot == BITMAP_ERROR) {
+		slot = bitmap_scan_and_flip(swap_table, 0, cnt, false);
+	}
+	if (slot != BITMAP_ERROR) {
+		size_t i;
+
+		for (i = 0; i < cnt; i++) {
+			swap_refs[slot + i] = 1;
+		}
+		swap_cursor = slot + cnt;
+	}
+	return slot;
+}
+
+/* Drops a reference to swap SLOT.  Once no page refers to it, frees
+ * the slot and any copy of it in the swap cache.  Call with swap_lock
+ * held. */
+static void
+swap_free (size_t slot) {
+	struct swap_cache_entry *e;
+
+	ASSERT (swap_refs[slot] > 0);
+	if (--swap_refs[slot] > 0) {
+		return;
+	}
+	e = swap_cache_find(slot);
+	if (e != NULL) {
+		swap_cache_drop(e);
+	}
+	bitmap_set(swap_table, slot, false);
+}
+
+/* Returns the swap cache entry for SLOT, or NULL. */
+static struct swap_cache_entry *
+swap_cache_find (size_t slot) {
+	struct list_elem *el;
+
+	for (el = list_begin(&swap_cache); el != list_end(&swap_cache); el = list_next(el)) {
+		struct swap_cache_entry *e = list_entry(el, struct swap_cache_entry, elem);
+		if (e->slot == slot) {
+			return e;
+		}
+	}
+	return NULL;
+}
 
+/* Removes E from the swap cache and frees it. */
+static void
+swap_cache_drop (struct swap_cache_entry *e) {
+	list_remove(&e->elem);
+	swap_cache_cnt--;
+	palloc_free_page(e->kva);
+	free(e);
+}
+
+/* Reads swap SLOT into KVA.  The in-use slots right after it, up to
+ * SWAP_CLUSTER pages in all, come along in the same request and go
+ * into the swap cache: with clustered swap-out they were most likely
+ * evicted together with SLOT and will be faulted on next.  Call with
+ * swap_lock held. */
+static void
+swap_read_ahead (size_t slot, void *kva) {
+	struct disk_iov iov[SWAP_CLUSTER];
+	struct swap_cache_entry *ahead[SWAP_CLUSTER];
+	size_t cnt = 1, i;
+
+	iov[0].buffer = kva;
+	iov[0].sector_cnt = SECTORS_PER_PAGE;
+	while (cnt < SWAP_CLUSTER) {
+		size_t next = slot + cnt;
+		struct swap_cache_entry *e;
+
+		if (next >= bitmap_size(swap_table) || !bitmap_test(swap_table, next)
+				|| swap_cache_find(next) != NULL) {
+			break;
+		}
+		e = malloc(sizeof *e);
+		if (e == NULL) {
+			break;
+		}
+		e->kva = palloc_get_page(0);
+		if (e->kva == NULL) {
+			free(e);
+			break;
+		}
+		e->slot = next;
+		ahead[cnt] = e;
+		iov[cnt].buffer = e->kva;
+		iov[cnt].sector_cnt = SECTORS_PER_PAGE;
+		cnt++;
+	}
+	disk_readv(swap_disk, slot * SECTORS_PER_PAGE, iov, cnt);
+
+	for (i = 1; i < cnt; i++) {
+		if (swap_cache_cnt == SWAP_CACHE_PAGES) {
+			swap_cache_drop(list_entry(list_front(&swap_cache), struct swap_cache_entry, elem));
+		}
+		list_push_back(&swap_cache, &ahead[i]->elem);
+		swap_cache_cnt++;
+	}
 }
@@ -0,0 +1,103 @@
+/* fault_stat.c: Page fault latency statistics.
+ *
+ * Every fault taken by vm_try_handle_fault() is timed with the
+ * time-stamp counter and counted in a log2 histogram for its class.
+ * The part of that time the faulting thread spent in disk requests
+ * (swap-in, file reads, and any eviction it had to do itself) is kept
+ * apart from the rest, which is copying, zeroing and bookkeeping. */
+
+#include "vm/fault_stat.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+/* Statistics of one class. */
+struct fault_hist {
+	long long cnt;                      /* Faults. */
+	uint64_t cycles;                    /* Cycles spent on them... */
+	uint64_t disk_cycles;               /* ...of which in disk requests. */
+	long long bucket[FAULT_BUCKET_CNT]; /* Latency histogram. */
+};
+
+static struct fault_hist hists[FAULT_CLASS_CNT];
+
+static const char *class_names[FAULT_CLASS_CNT] = {
+	"stack growth", "lazy file", "lazy anon", "swap-in",
+	"write-protect", "invalid",
+};
+
+static void inspect_fault_stat (struct intr_frame *f);
+
+/* Registers the inspect interrupt. */
+void
+fault_stat_init (void) {
+	intr_register_int (0x46, 3, INTR_OFF, inspect_fault_stat,
+			"Inspect Page Fault Latency");
+}
+
+/* Counts a fault of class CLS that took CYCLES, DISK_CYCLES of them
+ * waiting on the disk. */
+void
+fault_stat_record (enum fault_class cls, uint64_t cycles,
+		uint64_t disk_cycles) {
+	struct fault_hist *h = &hists[cls];
+	int bucket = cycles > 0 ? 63 - __builtin_clzll (cycles) : 0;
+	enum intr_level old_level;
+
+	ASSERT (cls < FAULT_CLASS_CNT);
+
+	old_level = intr_disable ();
+	h->cnt++;
+	h->cycles += cycles;
+	h->disk_cycles += disk_cycles;
+	h->bucket[bucket]++;
+	intr_set_level (old_level);
+}
+
+/* Prints the statistics of each class that saw a fault. */
+void
+fault_stat_print (void) {
+	int cls, i;
+
+	for (cls = 0; cls < FAULT_CLASS_CNT; cls++) {
+		const struct fault_hist *h = &hists[cls];
+		unsigned long long avg, disk_pct;
+
+		if (h->cnt == 0)
+			continue;
+		avg = h->cycles / h->cnt;
+		disk_pct = h->cycles > 0 ? h->disk_cycles * 100 / h->cycles : 0;
+		printf ("Page faults, %s: %lld, %llu cycles average, "
+				"%llu%% disk wait, %llu%% copy\n",
+				class_names[cls], h->cnt, avg, disk_pct, 100 - disk_pct);
+		for (i = 0; i < FAULT_BUCKET_CNT; i++)
+			if (h->bucket[i] != 0)
+				printf ("  2^%d cycles: %lld\n", i, h->bucket[i]);
+	}
+}
+
+/* Tool for measuring fault latency. Calling this function via int 0x46.
+ * Input:
+ *   @RAX - Fault class.
+ *   @RDX - Histogram bucket, or -1 for the class totals.
+ * Output:
+ *   @RAX - Faults in the bucket, or in the class.
+ *   @RDX - Cycles spent on faults of the class (totals only).
+ *   @RCX - Of those, cycles spent waiting on the disk (totals only). */
+static void
+inspect_fault_stat (struct intr_frame *f) {
+	uint64_t cls = f->R.rax;
+	int64_t bucket = f->R.rdx;
+
+	if (cls >= FAULT_CLASS_CNT || bucket >= FAULT_BUCKET_CNT || bucket < -1) {
+		f->R.rax = 0;
+		return;
+	}
+	if (bucket >= 0) {
+		f->R.rax = hists[cls].bucket[bucket];
+	} else {
+		f->R.rax = hists[cls].cnt;
+		f->R.rdx = hists[cls].cycles;
+		f->R.rcx = hists[cls].disk_cycles;
+	}
+}
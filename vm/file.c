@@ -1,15 +1,29 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <round.h>
+#include <string.h>
 #include "vm/vm.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 
+/* Most dirty pages gathered into one write by mmap_writeback(). */
+#define WRITEBACK_BATCH 8
+
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
+static bool mmap_writeback (struct vm_area *area, void *start, void *end);
+static off_t read_run (struct file *file, void *buffer, off_t size,
+    off_t file_ofs, bool direct);
+
+/* Snapshots of dirty mapped pages on their way to disk. */
+static uint8_t *writeback_bounce;   /* WRITEBACK_BATCH pages. */
+static struct lock writeback_lock;  /* Protects writeback_bounce. */
 
-bool f_load_segment(struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes, uint32_t zero_bytes, bool writable);
-bool f_lazy_load_segment(struct page *page, void *aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -22,31 +36,29 @@ static const struct page_operations file_ops = {
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	writeback_bounce = palloc_get_multiple(PAL_ASSERT, WRITEBACK_BATCH);
+	lock_init(&writeback_lock);
 }
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED, void *kva) {
 	/* Set up the handler */
-  // struct lazy_load_info *load_info = (struct lazy_load_info *)page->uninit.aux;
+  /* Fetch first: file_page overlays the uninit_page that holds it. */
+  struct lazy_load_info *load_info = (struct lazy_load_info *)page->uninit.aux;
 
-  // ASSERT(load_info != NULL);
+  ASSERT(load_info != NULL);
 
 	page->operations = &file_ops;
 	
 	struct file_page *file_page = &page->file;
 
-  if (type & VM_MARKER_1) {
-    file_page->header = true;
-  } else {
-    file_page->header = false;
-  }
-
-  // file_page->file = load_info->file;
-  // file_page->ofs = load_info->ofs;
-  // file_page->read_bytes = load_info->read_bytes;
-  // file_page->zero_bytes = load_info->zero_bytes;
+  file_page->file = load_info->file;
+  file_page->ofs = load_info->ofs;
+  file_page->read_bytes = load_info->read_bytes;
+  file_page->zero_bytes = load_info->zero_bytes;
 
+  return true;
 }
 
 /* Swap in the page by read contents from the file. */
@@ -54,8 +66,7 @@ static bool
 file_backed_swap_in (struct page *page, void *kva) {
 	struct file_page *file_page UNUSED = &page->file;
 
-  file_seek(file_page->file, file_page->ofs);
-  if(file_read(file_page->file, kva, file_page->read_bytes) != (int)file_page->read_bytes){
+  if(file_read_at(file_page->file, kva, file_page->read_bytes, file_page->ofs) != (int)file_page->read_bytes){
     return false;
   }
 
@@ -67,15 +78,16 @@ file_backed_swap_in (struct page *page, void *kva) {
 static bool
 file_backed_swap_out (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
-  struct thread *cur = thread_current();
-
-  if (pml4_is_dirty(cur->pml4, page->va)) {
-    // lock_acquire(inode_get_lock(file_get_inode(page->file.file)));
-    file_write_at(file_page->file, page->va, file_page->read_bytes, file_page->ofs);
-    // lock_release(inode_get_lock(file_get_inode(page->file.file)));
-    pml4_set_dirty(cur->pml4, page->va, 0);
+  uint64_t *pml4 = page->owner->pml4;  // victim이 다른 process의 page일 수 있음
+
+  /* Unmap first so that the owner cannot dirty the page again while it
+   * is written back.  Clearing the mapping keeps the dirty bit. */
+  pml4_clear_page(pml4, page->va);
+  if (pml4_is_dirty(pml4, page->va)) {
+    pml4_set_dirty(pml4, page->va, 0);
+    file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->ofs);
   }
-  pml4_clear_page(cur->pml4, page->va);
+  return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
@@ -92,137 +104,218 @@ file_backed_destroy (struct page *page) {
 
 	// pml4_clear_page(thread_current()->pml4, page->va);
 	// file_close(aux->file);
-}
-
-bool f_load_segment(struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
-  ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
-  ASSERT(pg_ofs(upage) == 0);
-  ASSERT(ofs % PGSIZE == 0);
-
-  bool header = true;
-
-  while (read_bytes > 0 || zero_bytes > 0) {
-    /* Do calculate how to fill this page.
-     * We will read PAGE_READ_BYTES bytes from FILE
-     * and zero the final PAGE_ZERO_BYTES bytes. */
-    size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-    size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-    /* TODO: Set up aux to pass information to the lazy_load_segment. */
-    struct lazy_load_info *aux = malloc(sizeof(struct lazy_load_info));
-    if (!aux) {
-      return false;
-    }
-
-    aux->file = file;
-    aux->ofs = ofs;
-    aux->read_bytes = page_read_bytes;
-    aux->zero_bytes = page_zero_bytes;
-    aux->writable = writable;
-
-    if (header) {  // header page인 경우
-      if(!vm_alloc_page_with_initializer(VM_FILE | VM_MARKER_1, upage, writable, f_lazy_load_segment, aux)) {
-        header = false;
-        return false;
-      }
-      header = false;
-    } else {  // header page가 아닌 경우
-      if (!vm_alloc_page_with_initializer(VM_FILE, upage, writable, f_lazy_load_segment, aux)) {
-        return false;
-      }
-    }
-
-    /* Advance. */
-    read_bytes -= page_read_bytes;
-    zero_bytes -= page_zero_bytes;
-    upage += PGSIZE;
-    ofs += page_read_bytes;
-  }
-  return true;
+	vm_release_frame(page);
 }
 
 bool f_lazy_load_segment(struct page *page, void *aux) {
   /* TODO: Load the segment from the file */
   /* TODO: This called when the first page fault occurs on address VA. */
   /* TODO: VA is available when calling this function. */
-  struct lazy_load_info *load_info = (struct lazy_load_info *)aux;
-  	struct file_page *file_page = &page->file;
-  struct file *file = load_info->file;
-  off_t ofs = load_info->ofs;
-  size_t read_bytes = load_info->read_bytes;
-  size_t zero_bytes = load_info->zero_bytes;
-
-  file_page->file = file;
-  file_page->ofs = ofs;
-  file_page->read_bytes = read_bytes;
-  file_page->zero_bytes = zero_bytes;
-
-  free(load_info);
-  
-  void *upage = page->va;
+  struct file_page *file_page = &page->file;  // file_backed_initializer가 채워둠
   void *kpage = page->frame->kva;
 
-  file_seek(file, ofs);
-  if (file_read(file, kpage, read_bytes) != (int)read_bytes) {
-    palloc_free_page(page->frame->kva);
+  free(aux);
+
+  if (file_read_at(file_page->file, kpage, file_page->read_bytes, file_page->ofs) != (int)file_page->read_bytes) {
     return false;
   }
 
-  memset(kpage + read_bytes, 0, zero_bytes);
+  memset(kpage + file_page->read_bytes, 0, file_page->zero_bytes);
   return true;
 }
 
-/* Do the mmap */
+/* Do the mmap.  The mapping is recorded as a single area; its pages
+ * are read from the file as they are touched, into frames shared with
+ * every other mapping of the file (see vm_claim_cached()).  Each page
+ * holds the whole page of the file, even past LENGTH. */
 void *
 do_mmap (void *addr, size_t length, int writable, struct file *file, off_t offset) {
-	struct file *new_file = file_reopen(file);
-	
-	size_t read_bytes = length > file_length(file) ? file_length(file) : length;
-	size_t zero_bytes = PGSIZE - read_bytes % PGSIZE;
-	
-	if (!f_load_segment(new_file, offset, addr, read_bytes, zero_bytes, writable)) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	off_t file_len = file_length(file);
+	void *end = addr + ROUND_UP(length, PGSIZE);
+	struct file *new_file;
+	size_t read_bytes;
+
+	if (offset >= file_len || end <= addr || !is_user_vaddr(end - 1)
+			|| !spt_range_free(spt, addr, end)) {
+		return NULL;
+	}
+	/* The mapping holds no more of the file than LENGTH covers. */
+	read_bytes = (size_t) (file_len - offset) < length ? (size_t) (file_len - offset) : length;
+
+	new_file = file_reopen(file);
+	if (new_file == NULL) {
 		return NULL;
 	}
+	if (!vm_alloc_area(VM_FILE, addr, length, writable, new_file, offset, read_bytes, f_lazy_load_segment)) {
+		file_close(new_file);
+		return NULL;
+	}
+	/* Under mlockall(MCL_FUTURE), locked as far as the limits allow. */
+	if (thread_current()->mlock_future) {
+		do_mlock(addr, length);
+	}
 	return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap.  Dirty pages are written back before the mapping's
+ * pages and its area are freed. */
 void
 do_munmap (void *addr) {
   struct thread *cur = thread_current();
-  struct file *org_file;
-  struct page *first_page = spt_find_page(&cur->spt, addr);
-  if (first_page == NULL)
+  struct vm_area *area = spt_find_area(&cur->spt, addr);
+
+  if (area == NULL || area->start != addr || VM_TYPE(area->type) != VM_FILE
+      || (area->type & VM_TEXT))
     return;
 
-  list_remove(&first_page->head_elem);  // head_list에서 header page의 head_elem제거
-  if (first_page->operations->type == VM_UNINIT) {
-    org_file = ((struct lazy_load_info *)first_page->uninit.aux)->file;
-  } else {
-    org_file = first_page->file.file;
+  mmap_writeback(area, area->start, area->end);
+  for (void *va = area->start; va < area->end; va += PGSIZE) {
+    struct page *page = spt_find_page(&cur->spt, va);
+    if (page != NULL)
+      spt_remove_page(&cur->spt, page);
   }
+  spt_remove_area(&cur->spt, area);
+  file_close(area->file);
+  free(area);
+}
 
-  while (true) {
-    struct page *page = spt_find_page(&cur->spt, addr);
-    if (page == NULL)
+/* Do the msync.  Writes back the pages of [ADDR, ADDR + LENGTH) that
+ * were written through any mapping of the file since they were last
+ * written back.  The range must lie inside one file mapping.  Returns
+ * false on a bad range or a failed write. */
+bool
+do_msync (void *addr, size_t length) {
+  struct vm_area *area = spt_find_area(&thread_current()->spt, addr);
+  void *end = addr + ROUND_UP(length, PGSIZE);
+
+  if (area == NULL || pg_ofs(addr) != 0 || end < addr || end > area->end
+      || VM_TYPE(area->type) != VM_FILE || (area->type & VM_TEXT))
+    return false;
+  return mmap_writeback(area, addr, end);
+}
+
+/* Writes back the dirty pages of file mapping AREA in [START, END).
+ * Runs of consecutive dirty pages, up to WRITEBACK_BATCH long, are
+ * snapshotted side by side and written with one file_write_at().
+ * Pages past the end of the file have nothing to write. */
+static bool
+mmap_writeback (struct vm_area *area, void *start, void *end) {
+  struct supplemental_page_table *spt = &thread_current()->spt;
+  size_t file_end = area->read_bytes;
+  size_t run_start = 0, run_cnt = 0;
+  bool success = true;
+
+  lock_acquire(&writeback_lock);
+  for (void *va = start; ; va += PGSIZE) {
+    size_t offset = va - area->start;
+    struct page *page = va < end && offset < file_end ? spt_find_page(spt, va) : NULL;
+
+    if (page != NULL && vm_frame_clean(page, writeback_bounce + run_cnt * PGSIZE)) {
+      if (run_cnt++ == 0)
+        run_start = offset;
+      if (run_cnt < WRITEBACK_BATCH)
+        continue;
+    }
+    if (run_cnt > 0) {
+      size_t run_end = run_start + run_cnt * PGSIZE;
+      off_t bytes = (run_end < file_end ? run_end : file_end) - run_start;
+
+      if (file_write_at(area->file, writeback_bounce, bytes, area->ofs + run_start) != bytes)
+        success = false;
+      run_cnt = 0;
+    }
+    if (va >= end || offset >= file_end)
       break;
-    if (page->operations->type == VM_UNINIT) {
-      if (((struct lazy_load_info *)page->uninit.aux)->file != org_file) {
-        break;
-      }
-    } else {
-      if (page->file.file != org_file) {
-        break;
-      }
-      if (pml4_is_dirty(cur->pml4, page->va)) {
-        // lock_acquire(inode_get_lock(file_get_inode(page->file.file)));
-        file_write_at(page->file.file, page->va, page->file.read_bytes, page->file.ofs);
-        // lock_release(inode_get_lock(file_get_inode(page->file.file)));
-        pml4_set_dirty(cur->pml4, page->va, 0);
-      }
-      pml4_clear_page(cur->pml4, page->va);
+  }
+  lock_release(&writeback_lock);
+  return success;
+}
+
+/* Reads SIZE bytes at FILE_OFS of FILE into BUFFER for
+ * file_cache_read(). */
+static off_t
+read_run (struct file *file, void *buffer, off_t size, off_t file_ofs,
+    bool direct) {
+  return direct ? file_read_at_direct(file, buffer, size, file_ofs)
+                : file_read_at(file, buffer, size, file_ofs);
+}
+
+/* Returns the running process's bounce page, through which
+ * file_cache_read() and file_cache_write() copy between a frame and a
+ * user buffer that may fault, allocating it on first use.  Returns
+ * NULL if no page is free.  process_cleanup() frees it. */
+static uint8_t *
+cache_bounce (void) {
+  struct thread *t = thread_current();
+
+  if (t->cache_bounce == NULL)
+    t->cache_bounce = palloc_get_page(0);
+  return t->cache_bounce;
+}
+
+/* Reads SIZE bytes from FILE at its position into BUFFER, like
+ * file_read(), taking pages that a mapping of the file holds from
+ * their frames, which may be newer than the disk.  Runs of other pages
+ * are read from disk in one file_read_at() each, or if DIRECT, with
+ * BUFFER pinned by vm_pin_buffer(), in one file_read_at_direct().  A
+ * pinned BUFFER cannot fault, so frames are copied straight into it;
+ * otherwise they go through the bounce page. */
+off_t
+file_cache_read (struct file *file, void *buffer, off_t size, bool direct) {
+  struct inode *inode = file_get_inode(file);
+  off_t pos = file_tell(file), len = file_length(file);
+  off_t done = 0, run = 0;
+  uint8_t *bounce = NULL;
+
+  if (size > len - pos)
+    size = len > pos ? len - pos : 0;
+  if (!direct && (bounce = cache_bounce()) == NULL)
+    return file_read(file, buffer, size);
+
+  while (done + run < size) {
+    off_t ofs = pos + done + run;
+    off_t chunk = PGSIZE - ofs % PGSIZE < size - done - run
+        ? PGSIZE - ofs % PGSIZE : size - done - run;
+
+    if (!vm_cache_read(inode, ofs, direct ? buffer + done + run : bounce, chunk)) {
+      run += chunk;
+      continue;
     }
-    addr += PGSIZE;
+    if (run > 0 && read_run(file, buffer + done, run, pos + done, direct) != run)
+      break;
+    done += run;
+    run = 0;
+    if (!direct)
+      memcpy(buffer + done, bounce, chunk);
+    done += chunk;
+  }
+  if (run > 0)
+    done += read_run(file, buffer + done, run, pos + done, direct);
+  file_seek(file, pos + done);
+  return done;
+}
+
+/* Writes SIZE bytes from BUFFER to FILE at its position, like
+ * file_write(), and copies them into any frame that maps the pages
+ * written, so that every mapping of the file sees them. */
+off_t
+file_cache_write (struct file *file, const void *buffer, off_t size) {
+  struct inode *inode = file_get_inode(file);
+  off_t pos = file_tell(file);
+  off_t written = file_write(file, buffer, size);
+  uint8_t *bounce = cache_bounce();
+  off_t done;
+
+  if (bounce == NULL)
+    return written;
+  for (done = 0; done < written; ) {
+    off_t ofs = pos + done;
+    off_t chunk = PGSIZE - ofs % PGSIZE < written - done ? PGSIZE - ofs % PGSIZE : written - done;
+
+    memcpy(bounce, buffer + done, chunk);
+    vm_cache_write(inode, ofs, bounce, chunk);
+    done += chunk;
   }
-  file_close(org_file);
-}
\ No newline at end of file
+  return written;
+}
@@ -1,13 +1,156 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
 #include "threads/malloc.h"
+#include "threads/mmu.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/fault_stat.h"
+#include "threads/io.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 
-struct list_elem *evict_start;
+/* Every frame handed to user pages, in clock order.  Replacement
+ * follows CLOCK-Pro: frames are hot (reused within a short interval) or
+ * cold, and two hands sweep the list.  The cold hand evicts unreferenced
+ * cold frames; the hot hand demotes unreferenced hot frames whenever
+ * hot frames take more than their share.  A cold page evicted while in
+ * its test period is remembered on TEST_LIST, and if it faults back
+ * before the test expires it comes back hot and the cold share grows. */
 struct list frame_table;
+static struct lock frame_lock;       /* Protects frame_table and the hands. */
+static struct list_elem *hand_cold;  /* Next frame the cold hand inspects. */
+static struct list_elem *hand_hot;   /* Next frame the hot hand inspects. */
+static size_t frame_cnt;             /* Frames in frame_table. */
+static size_t hot_cnt;               /* Hot frames in frame_table. */
+static size_t cold_target;           /* Adaptive number of cold frames. */
+static struct list test_list;        /* Evicted pages in their test period. */
+static size_t test_cnt;              /* Pages in test_list. */
+static struct condition evict_done;  /* Signaled when an eviction ends. */
+
+/* Background reclaim.  kswapd wakes when free user frames drop below
+ * free_low and evicts, writing dirty victims to their backing store,
+ * until free_high frames are free.  The frames it frees stay on
+ * FREE_FRAMES, ready for the next fault to take without any I/O. */
+static struct list free_frames;      /* Clean frames evicted by kswapd. */
+static size_t free_frame_cnt;        /* Frames in free_frames. */
+static size_t free_low, free_high;   /* Free frame watermarks. */
+static struct semaphore kswapd_sema; /* Upped to wake kswapd. */
+static bool kswapd_awake;            /* kswapd has been woken. */
+
+/* Frame cache.  Frames holding file data, for program text and file
+ * mappings alike, are indexed by the data in them, so that every
+ * process mapping a page of a file maps the same frame, and read() and
+ * write() on the file go through that frame too (see vm_cache_read()).
+ * A frame stays indexed while any page maps it. */
+static struct hash frame_cache;
+
+/* The zero frame.  A read fault on an anonymous page that would start
+ * out zeroed maps this frame read-only instead of a frame of its own;
+ * the first write gives the page a private frame through vm_handle_wp().
+ * It holds a reference of its own, so it is never freed, and it is not
+ * on the clock, so it is never evicted. */
+static struct frame zero_frame;
+
+/* Fault-around window for file-backed areas, in pages. */
+#define FAULT_AROUND_MIN 2
+#define FAULT_AROUND_MAX 16
+
+/* Working sets.  Every WS_INTERVAL ticks the next page fault, or
+ * kswapd, samples the accessed bit of every resident page.  A process's
+ * working set is its pages referenced within the last WS_WINDOW
+ * samples, and its page-fault frequency the faults it took in the last
+ * interval.  The cold hand takes frames from processes holding more
+ * than their working set first; a process taking more than PFF_HIGH
+ * faults an interval is short of frames, so all it holds is kept. */
+#define WS_INTERVAL 25
+#define WS_WINDOW 4
+#define PFF_HIGH 32
+#define WS_SKIP_MAX 32               /* Kept frames passed before one is taken. */
+static unsigned ws_epoch;            /* Samples taken so far. */
+static int64_t ws_last;              /* When the last sample was taken. */
+static size_t ws_total;              /* Frames in any working set. */
+static size_t user_frames;           /* Frames in the user pool. */
+
+/* Read-around for areas advised sequential, in pages, and how many
+ * pages behind a sequential fault stay resident before the pages
+ * further back are marked to be evicted first. */
+#define FAULT_AROUND_SEQ 64
+#define SEQ_KEEP_BEHIND 8
+
+/* Prefetch.  madvise(MADV_WILLNEED) queues the range for prefetchd,
+ * which fills its pages through their lazy loaders while the process
+ * runs on.  It holds the owner's SPT lock for each page it fills, and
+ * stops early when free frames run short or the owner's address space
+ * is torn down (see prefetch_cancel()). */
+struct prefetch_req {
+	struct thread *t;               /* Process to fill pages for. */
+	void *start, *end;              /* Range to fill. */
+	bool cancelled;                 /* T is tearing down its pages. */
+	struct list_elem elem;          /* Element in prefetch_queue. */
+};
+static struct list prefetch_queue;   /* Requests not yet started. */
+static struct prefetch_req *prefetch_cur;  /* Request being served. */
+static struct lock prefetch_lock;    /* Protects the two above. */
+static struct condition prefetch_cond;     /* Queue grew or request ended. */
+
+/* Same-page merging, off unless -ksm is given.  ksmd walks the clock
+ * with a hand of its own, KSM_SLEEP_MS apart, checksumming
+ * ksm_scan_pages anonymous frames each time.  A frame whose checksum
+ * held since its last visit is entered in KSM_TABLE; a later frame with
+ * the same checksum and the same bytes is merged into it, its page
+ * mapped read-only to the one frame like a page shared by fork, and its
+ * own frame freed.  A write to any page of a merged frame copies it
+ * back out (see vm_handle_wp()), and a merged frame is evicted like any
+ * frame shared by fork.  The table starts over with each pass. */
+#define KSM_SLEEP_MS 20
+unsigned ksm_scan_pages;             /* Frames checked per wakeup, 0: off. */
+static struct hash ksm_table;        /* Stable frames, by checksum. */
+static struct list_elem *hand_ksm;   /* Next frame ksmd checks, or NULL. */
+static long long ksm_scan_cnt;       /* Frames checksummed. */
+static long long ksm_merge_cnt;      /* Pages merged. */
+static size_t ksm_saved;             /* Pages now mapped to a merged frame. */
+static size_t ksm_saved_max;         /* Most ever at once. */
+
+/* Page locking.  mlock() brings a range in and counts its pages in
+ * the mlock_cnt of their frames; the clock passes over any frame a
+ * locked page maps.  A process may lock a quarter of the user pool and
+ * all processes together half of it.  vm_pin_buffer() counts pages in
+ * mlock_cnt the same way, outside the limits, for the length of one
+ * read into them.  Protected by frame_lock. */
+static size_t mlock_total;           /* Pages locked. */
+static size_t mlock_max;             /* Most pages locked at once. */
+static size_t mlock_proc_max;        /* Most pages one process may lock. */
+
+/* Admission control.  A process about to load a program waits while
+ * the working sets leave fewer than ADMIT_RESERVE frames, re-sampling
+ * every interval, for at most ADMIT_TRIES intervals. */
+#define ADMIT_RESERVE 32
+#define ADMIT_TRIES 8
+
+/* Page fault statistics. */
+static long long fault_cnt;          /* Faults resolved by the VM. */
+static long long evict_cnt;          /* Frames evicted. */
+
+static void inspect_fault_cnt (struct intr_frame *f);
+static uint64_t frame_cache_hash (const struct hash_elem *e, void *aux);
+static bool frame_cache_less (const struct hash_elem *a, const struct hash_elem *b, void *aux);
+static void kswapd (void *aux);
+static void prefetchd (void *aux);
+static void prefetch_cancel (struct thread *t);
+static void ksmd (void *aux);
+static uint64_t ksm_hash (const struct hash_elem *e, void *aux);
+static bool ksm_less (const struct hash_elem *a, const struct hash_elem *b, void *aux);
+static void ksm_forget (struct hash_elem *e, void *aux);
+static size_t vm_evict_frames (struct frame **victims, size_t max);
+static size_t vm_free_frames (void);
+static void vm_count_fault (void);
+static void ws_sample (void);
+static bool frame_over_working_set (struct frame *frame);
 
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
@@ -23,6 +166,84 @@ vm_init (void) {
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	list_init(&frame_table);
+	list_init(&test_list);
+	list_init(&free_frames);
+	hash_init(&frame_cache, frame_cache_hash, frame_cache_less, NULL);
+	hash_init(&ksm_table, ksm_hash, ksm_less, NULL);
+	lock_init(&frame_lock);
+	cond_init(&evict_done);
+	sema_init(&kswapd_sema, 0);
+	list_init(&prefetch_queue);
+	lock_init(&prefetch_lock);
+	cond_init(&prefetch_cond);
+
+	/* Reclaim starts at 1/64 of user memory and stops at twice that. */
+	zero_frame.kva = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+	list_init(&zero_frame.pages);
+	zero_frame.ref_cnt = 1;
+
+	user_frames = palloc_free_cnt(PAL_USER);
+	free_low = palloc_free_cnt(PAL_USER) / 64 + 1;
+	free_high = free_low * 2;
+	mlock_max = user_frames / 2;
+	mlock_proc_max = user_frames / 4;
+	thread_create("kswapd", PRI_DEFAULT, kswapd, NULL);
+	thread_create("prefetchd", PRI_DEFAULT, prefetchd, NULL);
+	if (ksm_scan_pages > 0) {
+		thread_create("ksmd", PRI_DEFAULT, ksmd, NULL);
+	}
+	intr_register_int (0x45, 3, INTR_OFF, inspect_fault_cnt, "Inspect Page Fault Count");
+	fault_stat_init ();
+}
+
+/* Keeps free user frames between the watermarks.  Victims are
+ * evicted up to SWAP_CLUSTER at a time, so their swap-out is one disk
+ * request, and written back without frame_lock held (see
+ * vm_evict_frames()), so page faults proceed while kswapd waits on
+ * the disk. */
+static void
+kswapd (void *aux UNUSED) {
+	struct frame *victims[SWAP_CLUSTER];
+
+	for (;;) {
+		sema_down(&kswapd_sema);
+
+		lock_acquire(&frame_lock);
+		if (timer_elapsed(ws_last) >= WS_INTERVAL) {
+			ws_sample();
+		}
+		while (vm_free_frames() < free_high && !list_empty(&frame_table)) {
+			size_t want = free_high - vm_free_frames();
+			size_t cnt, i;
+
+			cnt = vm_evict_frames(victims, want < SWAP_CLUSTER ? want : SWAP_CLUSTER);
+			if (cnt == 0) {
+				break;
+			}
+			for (i = 0; i < cnt; i++) {
+				list_push_back(&free_frames, &victims[i]->f_elem);
+				free_frame_cnt++;
+			}
+		}
+		kswapd_awake = false;
+		lock_release(&frame_lock);
+	}
+}
+
+/* Returns the number of user frames available without eviction. */
+static size_t
+vm_free_frames (void) {
+	return palloc_free_cnt(PAL_USER) + free_frame_cnt;
+}
+
+/* Tool for measuring paging behaviour. Calling this function via int 0x45.
+ * Output:
+ *   @RAX - Number of page faults resolved so far.
+ *   @RDX - Number of frames evicted so far. */
+static void
+inspect_fault_cnt (struct intr_frame *f) {
+	f->R.rax = fault_cnt;
+	f->R.rdx = evict_cnt;
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -43,7 +264,36 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
-static struct frame *vm_evict_frame (void);
+static bool vm_alloc_page_for (struct thread *owner, enum vm_type type,
+		void *upage, bool writable, vm_initializer *init, void *aux);
+static struct page *spt_get_page_of (struct thread *owner, void *va);
+static bool vm_claim_cached (struct page *page, struct vm_area *area);
+static bool vm_claim_zero_page (void *va);
+static bool page_is_zero_fill (struct page *page);
+static void vm_drop_behind (struct vm_area *area, void *upage);
+static void clock_move_to_hand (struct frame *frame);
+static struct frame *frame_cache_find (struct frame *key);
+static void frame_free (struct frame *frame);
+static void frame_add_page (struct frame *frame, struct page *page);
+static int frame_remove_page (struct page *page);
+static bool frame_is_accessed (struct frame *frame);
+static struct list_elem *clock_next (struct list_elem *e);
+static void clock_insert (struct frame *frame);
+static void clock_remove (struct frame *frame);
+static void clock_admit (struct frame *frame, struct page *page);
+static void clock_forget (struct page *page);
+static void clock_run_hot_hand (void);
+static enum fault_class fault_classify (void *addr, bool write, bool not_present);
+static void ksm_scan_frame (struct frame *frame, uint64_t sum);
+static bool ksm_candidate (struct frame *frame);
+static bool ksm_merge (struct frame *src, struct frame *dst);
+static bool vm_lock_page (struct page *page, bool reserved);
+static void vm_unlock_page (struct page *page);
+static bool vm_pin_page (struct page *page);
+static bool range_mapped (struct supplemental_page_table *spt, void *start, void *end);
+static bool range_locked (struct supplemental_page_table *spt, void *start, void *end);
+static int page_ptr_cmp (const void *a_, const void *b_);
+static bool vm_handle_wp (struct page *page);
 unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED);
 struct page *h_elem_to_page(struct hash_elem *h_elem);
 struct frame *elem_to_frame(struct list_elem *elem);
@@ -51,15 +301,367 @@ bool page_less (const struct hash_elem *a_, const struct hash_elem *b_, void *au
 bool insert_page (struct hash *spt_hash, struct page *p);
 bool delete_page (struct hash *spt_hash, struct page *p);
 
+/* Counts a page fault resolved for the current process, and takes a
+ * working-set sample if one is due. */
+static void
+vm_count_fault (void) {
+	struct thread *cur = thread_current();
+
+	fault_cnt++;
+	if (cur->pff_epoch != ws_epoch) {
+		cur->pff = cur->pff_epoch + 1 == ws_epoch ? cur->pff_faults : 0;
+		cur->pff_faults = 0;
+		cur->pff_epoch = ws_epoch;
+	}
+	cur->pff_faults++;
+
+	if (timer_elapsed(ws_last) >= WS_INTERVAL) {
+		lock_acquire(&frame_lock);
+		if (timer_elapsed(ws_last) >= WS_INTERVAL) {
+			ws_sample();
+		}
+		lock_release(&frame_lock);
+	}
+}
+
+/* Samples the working set of every process: the accessed bit of each
+ * resident page is read and cleared, and the pages referenced within
+ * the last WS_WINDOW samples are counted per owner.  The bits taken are
+ * kept in the frames for the clock (see frame_is_accessed()).  Call
+ * with frame_lock held. */
+static void
+ws_sample (void) {
+	struct list_elem *f, *e;
+
+	ws_epoch++;
+	ws_last = timer_ticks();
+	ws_total = 0;
+	for (f = list_begin(&frame_table); f != list_end(&frame_table); f = list_next(f)) {
+		struct frame *frame = elem_to_frame(f);
+		bool recent = false;
+
+		for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e)) {
+			struct page *page = list_entry(e, struct page, frame_elem);
+			struct thread *owner = page->owner;
+
+			if (owner->pml4 != NULL && pml4_is_accessed(owner->pml4, page->va)) {
+				pml4_set_accessed(owner->pml4, page->va, NOT_ACCESSED);
+				frame->referenced = true;
+				page->ws_epoch = ws_epoch;
+			}
+			if (ws_epoch - page->ws_epoch < WS_WINDOW) {
+				if (owner->ws_epoch != ws_epoch) {
+					owner->ws_epoch = ws_epoch;
+					owner->ws_cnt = 0;
+				}
+				owner->ws_cnt++;
+				recent = true;
+			}
+		}
+		if (recent) {
+			ws_total++;
+		}
+	}
+}
+
+/* Returns true if the process owning FRAME holds more frames than its
+ * working set and does not fault often enough to need them.  Call with
+ * frame_lock held. */
+static bool
+frame_over_working_set (struct frame *frame) {
+	struct thread *owner = frame->page->owner;
+	size_t wss = owner->ws_epoch == ws_epoch ? owner->ws_cnt : 0;
+	int pff = owner->pff_epoch == ws_epoch
+			? (owner->pff > owner->pff_faults ? owner->pff : owner->pff_faults)
+			: owner->pff_epoch + 1 == ws_epoch ? owner->pff_faults : 0;
+
+	return pff <= PFF_HIGH && owner->rss > wss;
+}
+
+/* Admission control for a process about to load a program.  Waits
+ * while the working sets of the running processes leave less than
+ * ADMIT_RESERVE user frames, so that a new process does not start by
+ * stealing frames they are using.  Idle processes drop out of the
+ * working sets as samples go by, so the process waits only while each
+ * sample finds the working sets smaller than the last, and for at most
+ * ADMIT_TRIES intervals; then it is admitted anyway. */
+void
+vm_admit (void) {
+	size_t last = SIZE_MAX;
+	int tries;
+
+	for (tries = 0; tries < ADMIT_TRIES; tries++) {
+		bool crowded;
+		size_t total;
+
+		lock_acquire(&frame_lock);
+		if (timer_elapsed(ws_last) >= WS_INTERVAL) {
+			ws_sample();
+		}
+		total = ws_total;
+		crowded = total + ADMIT_RESERVE > user_frames;
+		lock_release(&frame_lock);
+		if (!crowded || total >= last) {  // 더 기다려도 줄지 않음
+			return;
+		}
+		last = total;
+		timer_sleep(WS_INTERVAL);
+	}
+}
+
+/* Serves prefetch requests one at a time, filling each page of the
+ * range that is not resident and has data to fill it with.  The
+ * owner's SPT lock is taken under prefetch_lock and held while one page
+ * is filled, so that the owner cannot change its table meanwhile and
+ * prefetch_cancel() can stop the request between pages. */
+static void
+prefetchd (void *aux UNUSED) {
+	for (;;) {
+		struct prefetch_req *req;
+		void *va;
+
+		lock_acquire(&prefetch_lock);
+		while (list_empty(&prefetch_queue)) {
+			cond_wait(&prefetch_cond, &prefetch_lock);
+		}
+		req = list_entry(list_pop_front(&prefetch_queue), struct prefetch_req, elem);
+		prefetch_cur = req;
+
+		for (va = req->start; va < req->end && !req->cancelled; va += PGSIZE) {
+			struct supplemental_page_table *spt = &req->t->spt;
+			struct page *page;
+
+			if (vm_free_frames() <= free_high) {
+				break;
+			}
+			lock_acquire(&spt->lock);
+			lock_release(&prefetch_lock);
+			page = spt_get_page_of(req->t, va);
+			if (page != NULL && page->frame == NULL && !page_is_zero_fill(page)) {
+				vm_do_claim_page(page);
+			}
+			lock_release(&spt->lock);
+			lock_acquire(&prefetch_lock);
+		}
+
+		prefetch_cur = NULL;
+		cond_broadcast(&prefetch_cond, &prefetch_lock);
+		lock_release(&prefetch_lock);
+		free(req);
+	}
+}
+
+/* Drops the prefetch requests of T, which is tearing down its address
+ * space, and waits for prefetchd to leave the one it is serving. */
+static void
+prefetch_cancel (struct thread *t) {
+	struct list_elem *e;
+
+	lock_acquire(&prefetch_lock);
+	for (e = list_begin(&prefetch_queue); e != list_end(&prefetch_queue); ) {
+		struct prefetch_req *req = list_entry(e, struct prefetch_req, elem);
+
+		e = list_next(e);
+		if (req->t == t) {
+			list_remove(&req->elem);
+			free(req);
+		}
+	}
+	while (prefetch_cur != NULL && prefetch_cur->t == t) {
+		prefetch_cur->cancelled = true;
+		cond_wait(&prefetch_cond, &prefetch_lock);
+	}
+	lock_release(&prefetch_lock);
+}
+
+/* Checks ksm_scan_pages frames every KSM_SLEEP_MS, taking frame_lock
+ * for one frame at a time.  The frame is checksummed with the lock
+ * released, marked as being evicted so that it is neither freed nor
+ * taken meanwhile. */
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		unsigned i;
+
+		timer_msleep(KSM_SLEEP_MS);
+		for (i = 0; i < ksm_scan_pages; i++) {
+			struct frame *frame;
+			uint64_t sum;
+
+			lock_acquire(&frame_lock);
+			if (list_empty(&frame_table)) {
+				lock_release(&frame_lock);
+				break;
+			}
+			if (hand_ksm == NULL) {  // 새 pass: 지난 pass의 table은 버림
+				hash_clear(&ksm_table, ksm_forget);
+				hand_ksm = list_begin(&frame_table);
+			}
+			frame = elem_to_frame(hand_ksm);
+			hand_ksm = list_next(hand_ksm);
+			if (hand_ksm == list_end(&frame_table)) {
+				hand_ksm = NULL;
+			}
+			if (!ksm_candidate(frame)) {
+				lock_release(&frame_lock);
+				continue;
+			}
+			frame->evicting = true;
+			lock_release(&frame_lock);
+
+			sum = hash_bytes(frame->kva, PGSIZE);
+
+			lock_acquire(&frame_lock);
+			frame->evicting = false;
+			cond_broadcast(&evict_done, &frame_lock);
+			ksm_scan_frame(frame, sum);
+			lock_release(&frame_lock);
+		}
+	}
+}
+
+/* Takes SUM, FRAME's checksum, and if it has not changed since ksmd
+ * last saw the frame, merges the frame with one of the same contents
+ * or enters it in ksm_table.  Of two frames to merge, the one shared
+ * already is kept.  The other frame's checksum is not taken again:
+ * ksm_merge() compares the bytes anyway.  Call with frame_lock held. */
+static void
+ksm_scan_frame (struct frame *frame, uint64_t sum) {
+	struct hash_elem *e;
+	struct frame *other;
+
+	if (!ksm_candidate(frame)) {
+		return;
+	}
+	ksm_scan_cnt++;
+	if (sum != frame->ksm_sum) {  // 자주 바뀌는 page는 합치지 않음
+		if (frame->ksm) {
+			hash_delete(&ksm_table, &frame->ksm_elem);
+			frame->ksm = false;
+		}
+		frame->ksm_sum = sum;
+		return;
+	}
+	if (frame->ksm) {
+		return;
+	}
+
+	e = hash_find(&ksm_table, &frame->ksm_elem);
+	if (e == NULL) {
+		hash_insert(&ksm_table, &frame->ksm_elem);
+		frame->ksm = true;
+		return;
+	}
+	other = hash_entry(e, struct frame, ksm_elem);
+	if (!ksm_candidate(other)) {
+		hash_replace(&ksm_table, &frame->ksm_elem);
+		other->ksm = false;
+		frame->ksm = true;
+	} else if (frame->ref_cnt == 1) {
+		ksm_merge(frame, other);
+	} else if (other->ref_cnt == 1 && ksm_merge(other, frame)) {
+		hash_insert(&ksm_table, &frame->ksm_elem);
+		frame->ksm = true;
+	}
+}
+
+/* Returns true if FRAME holds an anonymous page that ksmd may merge:
+ * resident, settled, and with contents its owner still wants. */
+static bool
+ksm_candidate (struct frame *frame) {
+	struct page *page = frame->page;
+
+	return page != NULL && !frame->pinned && !frame->evicting && !frame->drop
+			&& frame->mlock_cnt == 0 && frame->inode == NULL
+			&& VM_TYPE(page->operations->type) == VM_ANON
+			&& !page->anon.lazy_free && page->owner->pml4 != NULL;
+}
+
+/* Maps the single page of SRC to DST instead, if the two hold the same
+ * bytes, and frees SRC.  Returns false, changing nothing, if they
+ * differ or an owner involved is in the middle of a fault.  Owners are
+ * locked so that none is deciding how to resolve a write fault on
+ * either frame; the comparison and remapping run with interrupts off,
+ * so that no process writes either frame in between.  Call with
+ * frame_lock held. */
+static bool
+ksm_merge (struct frame *src, struct frame *dst) {
+	struct page *page = src->page;
+	struct thread *owner = page->owner;
+	struct thread *dst_owner = dst->ref_cnt == 1 && dst->page->owner != owner
+			? dst->page->owner : NULL;
+	enum intr_level old_level;
+	struct list_elem *e;
+	bool same;
+
+	ASSERT (src->ref_cnt == 1);
+
+	if (!lock_try_acquire(&owner->spt.lock)) {
+		return false;
+	}
+	if (dst_owner != NULL && !lock_try_acquire(&dst_owner->spt.lock)) {
+		lock_release(&owner->spt.lock);
+		return false;
+	}
+
+	old_level = intr_disable();
+	same = memcmp(src->kva, dst->kva, PGSIZE) == 0;
+	if (same) {
+		for (e = list_begin(&dst->pages); e != list_end(&dst->pages); e = list_next(e)) {
+			struct page *p = list_entry(e, struct page, frame_elem);
+			if (p->owner->pml4 != NULL) {
+				pml4_set_writable(p->owner->pml4, p->va, false);
+			}
+		}
+		pml4_clear_page(owner->pml4, page->va);
+		pml4_set_page(owner->pml4, page->va, dst->kva, false);
+		frame_remove_page(page);
+		frame_add_page(dst, page);
+	}
+	intr_set_level(old_level);
+
+	if (dst_owner != NULL) {
+		lock_release(&dst_owner->spt.lock);
+	}
+	lock_release(&owner->spt.lock);
+	if (!same) {
+		return false;
+	}
+
+	frame_free(src);
+	page->merged = true;
+	ksm_merge_cnt++;
+	if (++ksm_saved > ksm_saved_max) {
+		ksm_saved_max = ksm_saved;
+	}
+	return true;
+}
+
+/* Prints same-page merging statistics. */
+void
+ksm_print_stats (void) {
+	printf("KSM: %lld pages scanned, %lld pages merged, %zu frames saved at most\n",
+			ksm_scan_cnt, ksm_merge_cnt, ksm_saved_max);
+}
+
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
  * `vm_alloc_page`. */
 bool
 vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, vm_initializer *init, void *aux) {
+	return vm_alloc_page_for(thread_current(), type, upage, writable, init, aux);
+}
+
+/* Like vm_alloc_page_with_initializer(), but creates the page in the
+ * SPT of OWNER, which need not be the running thread: prefetchd
+ * creates pages for the process it prefetches for. */
+static bool
+vm_alloc_page_for (struct thread *owner, enum vm_type type, void *upage,
+		bool writable, vm_initializer *init, void *aux) {
 
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
 
-	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct supplemental_page_table *spt = &owner->spt;
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
@@ -82,10 +684,9 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, v
 				break;
 		}
 		uninit_new(page, upage, init, type, aux, initializer);
-		if (type & VM_MARKER_1) { // mmap시 header page인 경우
-			list_push_back(&thread_current()->head_list, &page->head_elem);
-		}
 		page->writable = writable;
+		page->owner = owner;
+		page->clock_test = false;
 
 		return spt_insert_page(spt, page);
 	}
@@ -93,21 +694,177 @@ err:
 	return false;
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
+/* Find VA from spt and return page. On error, return NULL.
+ * Only pages that have been touched are found; see spt_get_page(). */
 struct page *
 spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	/* TODO: Fill this function. */
-	struct page *page  = (struct page *)malloc(sizeof(struct page));  // dummy page 생성
+	struct page key;  // hash 검색용 dummy page (malloc 없이 stack에)
 	struct hash_elem *e;
-	page->va = pg_round_down(va);  // va가 가리키는 가상 page의 시작 포인트 반환
-	e = hash_find(&spt->spt_hash, &page->h_elem);  // hash에서 hash_elem과 같은 요소를 검색해서 발견하면 발견한 hash elem 반환, 아니면 NULL반환
-	// if (e == NULL) {
-	// 	printf("hash_find 실패\n");
-	// }
-	free(page);  // hash elem을 찾기 위해 생성한 dummy page 해제
 
+	key.va = pg_round_down(va);
+	e = hash_find(&spt->spt_hash, &key.h_elem);
 	return e != NULL ? h_elem_to_page(e) : NULL;
-	// return e != NULL ? hash_entry(e, struct page, h_elem) : NULL;
+}
+
+/* Returns the page containing VA, creating it from the area that
+ * covers VA on first touch.  Returns NULL if VA is not mapped.  SPT
+ * must be the running thread's. */
+struct page *
+spt_get_page (struct supplemental_page_table *spt, void *va) {
+	ASSERT (spt == &thread_current()->spt);
+	return spt_get_page_of(thread_current(), va);
+}
+
+/* Like spt_get_page(), in the SPT of OWNER, which need not be the
+ * running thread.  Call with OWNER's SPT lock held if it is not. */
+static struct page *
+spt_get_page_of (struct thread *owner, void *va) {
+	struct supplemental_page_table *spt = &owner->spt;
+	struct page *page = spt_find_page(spt, va);
+	struct vm_area *area;
+	struct lazy_load_info *aux;
+	void *upage = pg_round_down(va);
+	size_t offset;
+
+	if (page != NULL) {
+		return page;
+	}
+	area = spt_find_area(spt, upage);
+	if (area == NULL) {
+		return NULL;
+	}
+
+	aux = malloc(sizeof *aux);
+	if (aux == NULL) {
+		return NULL;
+	}
+	offset = upage - area->start;
+	aux->file = area->file;
+	aux->ofs = area->ofs + offset;
+	aux->read_bytes = offset >= area->read_bytes ? 0
+			: area->read_bytes - offset < PGSIZE ? area->read_bytes - offset : PGSIZE;
+	aux->zero_bytes = PGSIZE - aux->read_bytes;
+	aux->writable = area->writable;
+	if (!vm_alloc_page_for(owner, area->type, upage, area->writable, area->init, aux)) {
+		free(aux);
+		return NULL;
+	}
+	return spt_find_page(spt, upage);
+}
+
+/* Returns the index of the first area in SPT that starts above VA. */
+static size_t
+area_upper_bound (struct supplemental_page_table *spt, void *va) {
+	size_t lo = 0, hi = spt->area_cnt;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (spt->areas[mid]->start <= va) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/* Returns the area of SPT containing VA, or NULL if there is none. */
+struct vm_area *
+spt_find_area (struct supplemental_page_table *spt, void *va) {
+	size_t i = area_upper_bound(spt, va);
+
+	if (i == 0 || spt->areas[i - 1]->end <= va) {
+		return NULL;
+	}
+	return spt->areas[i - 1];
+}
+
+/* Returns true if no area of SPT and no part of the current stack
+ * overlaps [START, END). */
+bool
+spt_range_free (struct supplemental_page_table *spt, void *start, void *end) {
+	void *stack_bottom = thread_current()->stack_bottom;
+	size_t i = area_upper_bound(spt, start);
+
+	if (i > 0 && spt->areas[i - 1]->end > start) {
+		return false;
+	}
+	if (i < spt->area_cnt && spt->areas[i]->start < end) {
+		return false;
+	}
+	if (stack_bottom != NULL && end > stack_bottom && start < (void *) USER_STACK) {
+		return false;
+	}
+	return true;
+}
+
+/* Inserts AREA into SPT.  Fails if AREA overlaps another area or
+ * memory runs out. */
+static bool
+spt_insert_area (struct supplemental_page_table *spt, struct vm_area *area) {
+	size_t i = area_upper_bound(spt, area->start);
+
+	if ((i > 0 && spt->areas[i - 1]->end > area->start)
+			|| (i < spt->area_cnt && spt->areas[i]->start < area->end)) {
+		return false;
+	}
+	if (spt->area_cnt == spt->area_cap) {
+		size_t cap = spt->area_cap ? spt->area_cap * 2 : 8;
+		struct vm_area **areas = realloc(spt->areas, cap * sizeof *areas);
+		if (areas == NULL) {
+			return false;
+		}
+		spt->areas = areas;
+		spt->area_cap = cap;
+	}
+	memmove(spt->areas + i + 1, spt->areas + i, (spt->area_cnt - i) * sizeof *spt->areas);
+	spt->areas[i] = area;
+	spt->area_cnt++;
+	return true;
+}
+
+/* Removes AREA from SPT.  The caller frees AREA and the pages in it. */
+void
+spt_remove_area (struct supplemental_page_table *spt, struct vm_area *area) {
+	size_t i = area_upper_bound(spt, area->start) - 1;
+
+	ASSERT (spt->areas[i] == area);
+	memmove(spt->areas + i, spt->areas + i + 1, (spt->area_cnt - i - 1) * sizeof *spt->areas);
+	spt->area_cnt--;
+}
+
+/* Maps LENGTH bytes at page-aligned START as one area of TYPE.  The
+ * first READ_BYTES bytes come from FILE at OFS through INIT and the rest
+ * is zeroed, one page at a time as the pages are touched. */
+bool
+vm_alloc_area (enum vm_type type, void *start, size_t length, bool writable,
+		struct file *file, off_t ofs, size_t read_bytes, vm_initializer *init) {
+	struct vm_area *area;
+
+	ASSERT (VM_TYPE(type) != VM_UNINIT);
+	ASSERT (pg_ofs(start) == 0);
+
+	area = malloc(sizeof *area);
+	if (area == NULL) {
+		return false;
+	}
+	area->start = start;
+	area->end = start + ROUND_UP(length, PGSIZE);
+	area->type = type;
+	area->writable = writable;
+	area->file = file;
+	area->ofs = ofs;
+	area->read_bytes = read_bytes;
+	area->init = init;
+	area->next_fault = NULL;
+	area->fault_around = FAULT_AROUND_MIN;
+	area->advice = ADV_NORMAL;
+	area->drop_cursor = NULL;
+	if (!spt_insert_area(&thread_current()->spt, area)) {
+		free(area);
+		return false;
+	}
+	return true;
 }
 
 /* Insert PAGE into spt with validation. */
@@ -121,111 +878,935 @@ spt_insert_page (struct supplemental_page_table *spt UNUSED, struct page *page U
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	hash_delete(&spt->spt_hash, &page->h_elem);
 	vm_dealloc_page (page);
-	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Get the struct frame, that will be evicted.
+ * Sweeps the cold hand until it meets an unreferenced cold frame.
+ * Referenced cold frames in their test period are promoted to hot; the
+ * others start a new test period.  Frames not yet linked to a page are
+ * passed over.  Returns NULL if no frame can be evicted.  Call with
+ * frame_lock held. */
 static struct frame *
 vm_get_victim (void) {
-	if(evict_start == NULL && !list_empty(&frame_table)){
-		evict_start = list_begin(&frame_table);
+	struct frame *fallback = NULL, *kept = NULL;
+	size_t budget = 3 * frame_cnt, kept_cnt = 0;
+
+	ASSERT (lock_held_by_current_thread(&frame_lock));
+	ASSERT (!list_empty(&frame_table));
+
+	if (hand_cold == NULL) {
+		hand_cold = list_begin(&frame_table);
 	}
+	while (budget-- > 0) {
+		struct frame *frame = elem_to_frame(hand_cold);
 
-	struct frame *victim = NULL;
-	struct thread *cur = thread_current();
-	struct list_elem *e = evict_start;
-	int cnt = 0;
+		hand_cold = clock_next(hand_cold);
+		if (frame->page == NULL || frame->pinned || frame->mlock_cnt > 0) {
+			continue;
+		}
+		if (fallback == NULL) {
+			fallback = frame;
+		}
+		if (frame->drop) {
+			return frame;
+		}
+		if (frame->hot) {
+			continue;
+		}
+		if (frame_is_accessed(frame)) {
+			if (frame->test) {
+				frame->hot = true;
+				frame->test = false;
+				hot_cnt++;
+				clock_run_hot_hand();
+			} else {
+				frame->test = true;
+			}
+			continue;
+		}
+		/* Pass over frames of processes within their working set, for a
+		 * while, in favour of processes holding more. */
+		if (!frame_over_working_set(frame)) {
+			if (kept == NULL) {
+				kept = frame;
+			}
+			if (++kept_cnt <= WS_SKIP_MAX) {
+				continue;
+			}
+			return kept;
+		}
+		return frame;
+	}
 
-	for (evict_start = e; evict_start != list_end(&frame_table); evict_start = list_next(evict_start)) {
-		victim = elem_to_frame(evict_start);
-		if (pml4_is_accessed(cur->pml4, victim->page->va)) {
-			pml4_set_accessed(cur->pml4, victim->page->va, NOT_ACCESSED);
-		} else {
-			return victim;
+	/* Every cold frame kept being referenced: take the first candidate,
+	 * if any frame could be evicted at all. */
+	return kept != NULL ? kept : fallback;
+}
+
+/* Evict up to MAX pages and store their frames, taken off the clock,
+ * in VICTIMS.  Returns the number evicted, 0 if no frame can be
+ * evicted.  Call with frame_lock held.  The lock is dropped while the
+ * pages are written out; meanwhile the frames are marked evicting, and
+ * anyone touching their pages waits on evict_done.  Anonymous victims
+ * are swapped out as one cluster (see anon_swap_out_cluster()), except
+ * frames shared copy-on-write or by ksmd, which are written once for
+ * all their pages (see anon_swap_out_shared()). */
+static size_t
+vm_evict_frames (struct frame **victims, size_t max) {
+	struct page *anon[SWAP_CLUSTER];
+	size_t cnt, anon_cnt = 0, i;
+
+	ASSERT (max <= SWAP_CLUSTER);
+
+	for (cnt = 0; cnt < max; cnt++) {
+		struct frame *victim = vm_get_victim ();
+		if (victim == NULL) {
+			break;
 		}
+		victim->evicting = true;
+		clock_remove(victim);
+		victims[cnt] = victim;
 	}
-	for (evict_start = list_begin(&frame_table); evict_start != e; evict_start = list_next(evict_start)) {
-		victim = elem_to_frame(evict_start);
-		if (pml4_is_accessed(cur->pml4, victim->page->va)) {
-			pml4_set_accessed(cur->pml4, victim->page->va, NOT_ACCESSED);
-		} else {
-			return victim;
+	if (cnt == 0) {
+		return 0;
+	}
+	lock_release(&frame_lock);
+
+	for (i = 0; i < cnt; i++) {
+		struct page *page = victims[i]->page;
+		struct list_elem *e;
+
+		if (VM_TYPE (page->operations->type) == VM_ANON) {
+			if (victims[i]->ref_cnt == 1) {
+				anon[anon_cnt++] = page;
+			} else if (!anon_swap_out_shared(victims[i])) {
+				PANIC ("vm_evict_frames: swap disk is full");
+			}
+			continue;
+		}
+		/* A cached file frame is unmapped from every process. */
+		for (e = list_begin(&victims[i]->pages); e != list_end(&victims[i]->pages); e = list_next(e)) {
+			page = list_entry(e, struct page, frame_elem);
+			if (!swap_out(page)) {
+				PANIC ("vm_evict_frames: cannot swap out page %p", page->va);
+			}
 		}
 	}
-	return victim;
-}
+	if (anon_cnt > 0 && !anon_swap_out_cluster(anon, anon_cnt)) {
+		PANIC ("vm_evict_frames: swap disk is full");
+	}
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame *
-vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
-	swap_out(victim->page);
-	return victim;
+	lock_acquire(&frame_lock);
+	for (i = 0; i < cnt; i++) {
+		struct frame *victim = victims[i];
+
+		if (victim->inode != NULL) {
+			hash_delete(&frame_cache, &victim->cache_elem);
+			victim->inode = NULL;
+		}
+		if (victim->ksm) {
+			hash_delete(&ksm_table, &victim->ksm_elem);
+			victim->ksm = false;
+		}
+		evict_cnt++;
+		while (victim->page != NULL) {
+			struct page *page = victim->page;
+
+			frame_remove_page(page);
+
+			/* A cold page evicted during its test period is remembered
+			 * so that a quick refault can prove it deserves to be hot. */
+			if (victim->test) {
+				page->clock_test = true;
+				list_push_back(&test_list, &page->test_elem);
+				if (++test_cnt > frame_cnt) {
+					struct page *old = list_entry(list_pop_front(&test_list), struct page, test_elem);
+					old->clock_test = false;
+					test_cnt--;
+					if (cold_target > 0) {
+						cold_target--;
+					}
+				}
+			}
+		}
+		victim->evicting = false;
+	}
+	cond_broadcast(&evict_done, &frame_lock);
+	return cnt;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.
+ * The frame comes back pinned so that it is not evicted while it is
+ * being filled; the caller unpins it. */
 static struct frame *
 vm_get_frame (void) {
 	/* TODO: Fill this function. */
-	struct frame *frame = (struct frame *)malloc(sizeof(struct frame));
-	frame->kva = palloc_get_page(PAL_USER);
+	struct frame *frame = NULL;
+	void *kva = palloc_get_page(PAL_USER);
 
-	if (frame->kva == NULL) {
-		frame = vm_evict_frame();
-		frame->page = NULL;
-		return frame;
+	lock_acquire(&frame_lock);
+	if (kva != NULL) {
+		frame = (struct frame *)malloc(sizeof(struct frame));
+		if (frame == NULL) {
+			palloc_free_page(kva);
+		} else {
+			frame->kva = kva;
+			frame_cnt++;
+		}
+	}
+	while (frame == NULL) {
+		if (!list_empty(&free_frames)) {  // kswapd가 미리 비워둔 frame
+			frame = list_entry(list_pop_front(&free_frames), struct frame, f_elem);
+			free_frame_cnt--;
+		} else if (!list_empty(&frame_table)) {  // 직접 evict
+			if (vm_evict_frames(&frame, 1) == 0) {
+				PANIC ("vm_get_frame: no evictable frame");
+			}
+		} else {  // 모든 frame이 kswapd에서 evict 중
+			cond_wait(&evict_done, &frame_lock);
+		}
 	}
-
-	list_push_back(&frame_table, &frame->f_elem);
 
 	frame->page = NULL;
+	list_init(&frame->pages);
+	frame->ref_cnt = 0;
+	frame->hot = false;
+	frame->test = false;
+	frame->evicting = false;
+	frame->pinned = true;
+	frame->mlock_cnt = 0;
+	frame->referenced = false;
+	frame->drop = false;
+	frame->inode = NULL;
+	frame->ksm = false;
+	frame->ksm_sum = 0;
+	clock_insert(frame);
+
+	if (!kswapd_awake && vm_free_frames() < free_low) {
+		kswapd_awake = true;
+		sema_up(&kswapd_sema);
+	}
+	lock_release(&frame_lock);
 
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Waits until PAGE is not being evicted.  Call with frame_lock held. */
 static void
-vm_stack_growth (void *addr UNUSED) {
-	if(vm_alloc_page(VM_ANON | VM_MARKER_0, addr, 1)){
-        vm_claim_page(addr);
-        thread_current()->stack_bottom -= PGSIZE;
-    }
+frame_wait_eviction (struct page *page) {
+	while (page->frame != NULL && page->frame->evicting) {
+		cond_wait(&evict_done, &frame_lock);
+	}
 }
 
-/* Handle the fault on write_protected page */
+/* Maps the untouched pages that follow the faulting page ADDR in a
+ * file-backed area, so that a sequential scan of an mmap or program
+ * text takes one fault per window rather than one per page.  The
+ * window doubles each time a fault lands where the previous window
+ * ended and falls back to FAULT_AROUND_MIN otherwise.  Only pages
+ * with file contents are mapped, and only while free frames are
+ * plentiful, so that speculation never forces an eviction. */
+static void
+vm_fault_around (void *addr) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *upage = pg_round_down(addr);
+	struct vm_area *area = spt_find_area(spt, upage);
+	void *end, *file_end, *va;
+
+	if (area == NULL || area->file == NULL || area->advice == ADV_RANDOM) {
+		return;
+	}
+	if (area->advice == ADV_SEQUENTIAL) {
+		area->fault_around = FAULT_AROUND_SEQ;
+	} else if (upage == area->next_fault) {
+		area->fault_around = area->fault_around * 2 < FAULT_AROUND_MAX
+				? area->fault_around * 2 : FAULT_AROUND_MAX;
+	} else {
+		area->fault_around = FAULT_AROUND_MIN;
+	}
+
+	end = upage + (area->fault_around + 1) * PGSIZE;
+	file_end = area->start + ROUND_UP(area->read_bytes, PGSIZE);
+	if (end > file_end) {
+		end = file_end;
+	}
+	if (end > area->end) {
+		end = area->end;
+	}
+	for (va = upage + PGSIZE; va < end; va += PGSIZE) {
+		struct page *page;
+
+		if (spt_find_page(spt, va) != NULL || vm_free_frames() <= free_high) {
+			break;
+		}
+		page = spt_get_page(spt, va);
+		if (page == NULL || !vm_do_claim_page(page)) {
+			break;
+		}
+	}
+	area->next_fault = va;
+}
+
+/* Marks the resident pages of sequentially advised AREA that lie more
+ * than SEQ_KEEP_BEHIND pages behind the fault at UPAGE, and that were
+ * not marked before, for eviction ahead of anything else: a sequential
+ * scan will not return to them.  Frames other pages share are left. */
+static void
+vm_drop_behind (struct vm_area *area, void *upage) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *va, *limit;
+
+	if (upage < area->start + SEQ_KEEP_BEHIND * PGSIZE) {
+		return;
+	}
+	limit = upage - SEQ_KEEP_BEHIND * PGSIZE;
+	va = area->drop_cursor != NULL && area->drop_cursor > area->start
+			? area->drop_cursor : area->start;
+
+	lock_acquire(&frame_lock);
+	for (; va < limit; va += PGSIZE) {
+		struct page *page = spt_find_page(spt, va);
+		struct frame *frame = page != NULL ? page->frame : NULL;
+
+		if (frame != NULL && frame != &zero_frame && frame->ref_cnt == 1
+				&& !frame->evicting && !frame->pinned && !frame->drop) {
+			frame->drop = true;
+			clock_move_to_hand(frame);
+		}
+	}
+	lock_release(&frame_lock);
+	if (area->drop_cursor == NULL || limit > area->drop_cursor) {
+		area->drop_cursor = limit;
+	}
+}
+
+/* Applies ADVICE to the pages in [ADDR, ADDR + LENGTH), which must all
+ * lie in areas.  RANDOM, SEQUENTIAL and NORMAL are kept by every area
+ * the range touches, as the access pattern of the whole area.  WILLNEED
+ * queues the range for prefetchd.  DONTNEED drops the pages, writing
+ * dirty mapped pages back first; they come back from the area as on
+ * first touch.  FREE gives up the contents of anonymous pages: a
+ * swapped-out page is freed now, and a resident one is dropped instead
+ * of swapped out if it is evicted before it is written again.  Returns
+ * false on a bad range or advice.  Call with the SPT lock held. */
+bool
+do_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *end = addr + ROUND_UP(length, PGSIZE);
+	struct vm_area *area;
+	void *va;
+
+	if (pg_ofs(addr) != 0 || end < addr || !is_user_vaddr(addr)
+			|| (end > addr && !is_user_vaddr(end - 1))) {
+		return false;
+	}
+	for (va = addr; va < end; va = area->end) {
+		area = spt_find_area(spt, va);
+		if (area == NULL) {
+			return false;
+		}
+	}
+
+	switch (advice) {
+		case ADV_NORMAL:
+		case ADV_RANDOM:
+		case ADV_SEQUENTIAL:
+			for (va = addr; va < end; va = area->end) {
+				area = spt_find_area(spt, va);
+				area->advice = advice;
+				area->fault_around = FAULT_AROUND_MIN;
+				area->drop_cursor = NULL;
+			}
+			return true;
+
+		case ADV_WILLNEED: {
+			struct prefetch_req *req;
+
+			if (addr == end) {
+				return true;
+			}
+			req = malloc(sizeof *req);
+			if (req == NULL) {
+				return false;
+			}
+			req->t = thread_current();
+			req->start = addr;
+			req->end = end;
+			req->cancelled = false;
+			lock_acquire(&prefetch_lock);
+			list_push_back(&prefetch_queue, &req->elem);
+			cond_broadcast(&prefetch_cond, &prefetch_lock);
+			lock_release(&prefetch_lock);
+			return true;
+		}
+
+		case ADV_DONTNEED:
+			if (range_locked(spt, addr, end)) {
+				return false;
+			}
+			for (va = addr; va < end; va = area->end) {
+				void *stop;
+
+				area = spt_find_area(spt, va);
+				stop = end < area->end ? end : area->end;
+				if (VM_TYPE(area->type) == VM_FILE && !(area->type & VM_TEXT)) {
+					do_msync(va, stop - va);
+				}
+				for (; va < stop; va += PGSIZE) {
+					struct page *page = spt_find_page(spt, va);
+					if (page != NULL) {
+						spt_remove_page(spt, page);
+					}
+				}
+			}
+			return true;
+
+		case ADV_FREE:
+			if (range_locked(spt, addr, end)) {
+				return false;
+			}
+			for (va = addr; va < end; va += PGSIZE) {
+				struct page *page = spt_find_page(spt, va);
+				struct frame *frame;
+
+				if (page == NULL || VM_TYPE(page->operations->type) != VM_ANON) {
+					continue;
+				}
+				lock_acquire(&frame_lock);
+				frame_wait_eviction(page);
+				frame = page->frame;
+				if (frame != NULL && frame != &zero_frame && frame->ref_cnt == 1) {
+					pml4_set_dirty(page->owner->pml4, page->va, false);
+					page->anon.lazy_free = true;
+				}
+				lock_release(&frame_lock);
+				if (frame == NULL) {
+					anon_discard(page);
+				}
+			}
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/* Growing the stack. */
+static void
+vm_stack_growth (void *addr UNUSED) {
+	if(vm_alloc_page(VM_ANON | VM_MARKER_0, addr, 1)){
+        vm_claim_page(addr);
+        thread_current()->stack_bottom -= PGSIZE;
+        if (thread_current()->mlock_future) {
+            vm_lock_page(spt_find_page(&thread_current()->spt, addr), false);
+        }
+    }
+}
+
+/* Locks the pages of the range ADDR..ADDR+LENGTH in memory, faulting
+ * them in now, with a private frame for each writable anonymous page
+ * so that no write faults later either.  Fails, locking nothing, if
+ * the range is not all mapped, would take the process or the system
+ * past its locked page limit, or cannot be brought in.  The pages not
+ * locked yet are counted against both limits before any is locked, so
+ * that processes locking at once cannot pass them together. */
+bool
+do_mlock (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct thread *t = thread_current();
+	void *start = pg_round_down(addr);
+	void *end = (void *) ROUND_UP((uint64_t) addr + length, PGSIZE);
+	size_t page_cnt = (end - start) / PGSIZE;
+	size_t new_cnt = 0, i;
+	bool *was_locked;
+	bool room;
+
+	if (!range_mapped(spt, start, end)) {
+		return false;
+	}
+	was_locked = malloc(page_cnt > 0 ? page_cnt : 1);
+	if (was_locked == NULL) {
+		return false;
+	}
+	for (i = 0; i < page_cnt; i++) {
+		struct page *page = spt_find_page(spt, start + i * PGSIZE);
+		was_locked[i] = page != NULL && page->locked;
+		if (!was_locked[i]) {
+			new_cnt++;
+		}
+	}
+
+	lock_acquire(&frame_lock);
+	room = t->mlock_cnt + new_cnt <= mlock_proc_max
+			&& mlock_total + new_cnt <= mlock_max;
+	if (room) {
+		t->mlock_cnt += new_cnt;
+		mlock_total += new_cnt;
+	}
+	lock_release(&frame_lock);
+	if (!room) {
+		free(was_locked);
+		return false;
+	}
+
+	for (i = 0; i < page_cnt; i++) {
+		if (!was_locked[i]
+				&& !vm_lock_page(spt_get_page(spt, start + i * PGSIZE), true)) {
+			break;
+		}
+	}
+	if (i < page_cnt) {
+		/* Undo: unlock what this call locked, and give back the rest
+		 * of the reservation. */
+		size_t undone = 0;
+
+		lock_acquire(&frame_lock);
+		for (i = 0; i < page_cnt; i++) {
+			struct page *page = spt_find_page(spt, start + i * PGSIZE);
+			if (!was_locked[i] && page != NULL && page->locked) {
+				vm_unlock_page(page);
+				undone++;
+			}
+		}
+		t->mlock_cnt -= new_cnt - undone;
+		mlock_total -= new_cnt - undone;
+		lock_release(&frame_lock);
+		free(was_locked);
+		return false;
+	}
+	free(was_locked);
+	return true;
+}
+
+/* Unlocks the pages of the range ADDR..ADDR+LENGTH, which must be
+ * mapped. */
+bool
+do_munlock (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *start = pg_round_down(addr);
+	void *end = (void *) ROUND_UP((uint64_t) addr + length, PGSIZE);
+	void *va;
+
+	if (!range_mapped(spt, start, end)) {
+		return false;
+	}
+	lock_acquire(&frame_lock);
+	for (va = start; va < end; va += PGSIZE) {
+		struct page *page = spt_find_page(spt, va);
+		if (page != NULL && page->locked) {
+			vm_unlock_page(page);
+		}
+	}
+	lock_release(&frame_lock);
+	return true;
+}
+
+/* Locks every page mapped now, for MLOCK_CURRENT, and every page
+ * mapped or grown onto the stack from now on, for MLOCK_FUTURE.  Fails,
+ * unlocking again the pages it locked, if some page cannot be locked;
+ * pages locked before the call stay locked. */
+bool
+do_mlockall (int flags) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct hash_iterator i;
+	struct page **was_locked;
+	size_t was_cnt = 0, a;
+
+	if (flags == 0 || (flags & ~(MLOCK_CURRENT | MLOCK_FUTURE)) != 0) {
+		return false;
+	}
+	if (flags & MLOCK_CURRENT) {
+		/* Remembers the pages locked already, sorted, for the undo. */
+		was_locked = malloc((hash_size(&spt->spt_hash) + 1) * sizeof *was_locked);
+		if (was_locked == NULL) {
+			return false;
+		}
+		hash_first(&i, &spt->spt_hash);
+		while (hash_next(&i)) {
+			struct page *page = h_elem_to_page(hash_cur(&i));
+			if (page->locked) {
+				was_locked[was_cnt++] = page;
+			}
+		}
+		qsort(was_locked, was_cnt, sizeof *was_locked, page_ptr_cmp);
+
+		for (a = 0; a < spt->area_cnt; a++) {
+			struct vm_area *area = spt->areas[a];
+			if (!do_mlock(area->start, area->end - area->start)) {
+				goto undo;
+			}
+		}
+		/* Stack pages belong to no area. */
+		hash_first(&i, &spt->spt_hash);
+		while (hash_next(&i)) {
+			struct page *page = h_elem_to_page(hash_cur(&i));
+			if (!page->locked && !vm_lock_page(page, false)) {
+				goto undo;
+			}
+		}
+		free(was_locked);
+	}
+	if (flags & MLOCK_FUTURE) {
+		thread_current()->mlock_future = true;
+	}
+	return true;
+
+undo:
+	lock_acquire(&frame_lock);
+	hash_first(&i, &spt->spt_hash);
+	while (hash_next(&i)) {
+		struct page *page = h_elem_to_page(hash_cur(&i));
+		if (page->locked && bsearch(&page, was_locked, was_cnt,
+				sizeof *was_locked, page_ptr_cmp) == NULL) {
+			vm_unlock_page(page);
+		}
+	}
+	lock_release(&frame_lock);
+	free(was_locked);
+	return false;
+}
+
+/* Orders pointers to pages by address, for qsort() and bsearch(). */
+static int
+page_ptr_cmp (const void *a_, const void *b_) {
+	const struct page *a = *(struct page * const *) a_;
+	const struct page *b = *(struct page * const *) b_;
+
+	return a < b ? -1 : a > b;
+}
+
+/* Unlocks every page and ends mlockall(MCL_FUTURE). */
+void
+do_munlockall (void) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct hash_iterator i;
+
+	thread_current()->mlock_future = false;
+	lock_acquire(&frame_lock);
+	hash_first(&i, &spt->spt_hash);
+	while (hash_next(&i)) {
+		struct page *page = h_elem_to_page(hash_cur(&i));
+		if (page->locked) {
+			vm_unlock_page(page);
+		}
+	}
+	lock_release(&frame_lock);
+}
+
+/* Brings PAGE into a frame and locks it there.  Returns false if it
+ * cannot be brought in or, unless RESERVED, its owner is at its locked
+ * page limit.  RESERVED means do_mlock() has already counted PAGE
+ * against the limits. */
+static bool
+vm_lock_page (struct page *page, bool reserved) {
+	struct thread *owner;
+
+	if (page == NULL) {
+		return false;
+	}
+	owner = page->owner;
+	for (;;) {
+		if (!vm_do_claim_page(page)) {
+			return false;
+		}
+		lock_acquire(&frame_lock);
+		frame_wait_eviction(page);
+		if (page->frame != NULL) {
+			break;
+		}
+		lock_release(&frame_lock);  // 그 사이 evict됨: 다시 불러옴
+	}
+	if (!page->locked) {
+		if (!reserved) {
+			if (owner->mlock_cnt >= mlock_proc_max || mlock_total >= mlock_max) {
+				lock_release(&frame_lock);
+				return false;
+			}
+			owner->mlock_cnt++;
+			mlock_total++;
+		}
+		page->locked = true;
+		page->frame->mlock_cnt++;
+	}
+	lock_release(&frame_lock);
+
+	if (page->writable && VM_TYPE(page->operations->type) == VM_ANON) {
+		return vm_handle_wp(page);
+	}
+	return true;
+}
+
+/* Unlocks PAGE.  Call with frame_lock held. */
+static void
+vm_unlock_page (struct page *page) {
+	ASSERT (page->locked);
+
+	page->locked = false;
+	if (page->frame != NULL) {
+		page->frame->mlock_cnt--;
+	}
+	page->owner->mlock_cnt--;
+	mlock_total--;
+}
+
+/* Pins the pages of the user buffer ADDR..ADDR+LENGTH in their frames,
+ * so that the kernel can read from a disk straight into them with no
+ * page fault while the disk is busy.  Each page is first brought into
+ * a frame of its own and mapped writable, as a write fault would.  The
+ * pins count toward no mlock() limit, and last only until
+ * vm_unpin_buffer(), which must come before the return to user mode.
+ * Returns false, pinning nothing, if some page is read-only or cannot
+ * be brought in.  Call with the current thread's spt lock held. */
+bool
+vm_pin_buffer (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *start = pg_round_down(addr);
+	void *end = (void *) ROUND_UP((uint64_t) addr + length, PGSIZE);
+	void *va;
+
+	for (va = start; va < end; va += PGSIZE) {
+		if (!vm_pin_page(spt_get_page(spt, va))) {
+			vm_unpin_buffer(start, va - start);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Unpins the pages of ADDR..ADDR+LENGTH, pinned by vm_pin_buffer().
+ * Call with the current thread's spt lock held. */
+void
+vm_unpin_buffer (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	void *start = pg_round_down(addr);
+	void *end = (void *) ROUND_UP((uint64_t) addr + length, PGSIZE);
+	void *va;
+
+	lock_acquire(&frame_lock);
+	for (va = start; va < end; va += PGSIZE) {
+		struct page *page = spt_find_page(spt, va);
+
+		ASSERT (page != NULL && page->frame != NULL);
+		page->frame->mlock_cnt--;
+	}
+	lock_release(&frame_lock);
+}
+
+/* Brings PAGE into a frame that no other page shares, mapped writable,
+ * and pins the frame for vm_pin_buffer().  Returns false if PAGE is
+ * missing or read-only or cannot be brought in. */
+static bool
+vm_pin_page (struct page *page) {
+	struct frame *frame;
+	uint64_t *pte;
+	bool success;
+
+	if (page == NULL || !page->writable) {
+		return false;
+	}
+	for (;;) {
+		if (!vm_do_claim_page(page)) {
+			return false;
+		}
+		lock_acquire(&frame_lock);
+		frame_wait_eviction(page);
+		frame = page->frame;
+		if (frame != NULL) {
+			frame->mlock_cnt++;
+		}
+		lock_release(&frame_lock);
+		if (frame == NULL) {
+			continue;  // 그 사이 evict됨: 다시 불러옴
+		}
+
+		pte = pml4e_walk(page->owner->pml4, (uint64_t) page->va, false);
+		if (pte != NULL && is_writable(pte)) {
+			return true;
+		}
+		/* Mapped read-only for copy-on-write.  The shared frame stays
+		 * pinned while PAGE gets its own, pinned on the next pass. */
+		success = pte != NULL && vm_handle_wp(page);
+		lock_acquire(&frame_lock);
+		frame->mlock_cnt--;
+		lock_release(&frame_lock);
+		if (!success) {
+			return false;
+		}
+	}
+}
+
+/* Returns true if every page from START to END is mapped, by a page
+ * of its own or by an area. */
+static bool
+range_mapped (struct supplemental_page_table *spt, void *start, void *end) {
+	void *va;
+
+	if (end < start || !is_user_vaddr(start) || (end > start && !is_user_vaddr(end - 1))) {
+		return false;
+	}
+	for (va = start; va < end; va += PGSIZE) {
+		if (spt_find_page(spt, va) == NULL && spt_find_area(spt, va) == NULL) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Returns true if any page from START to END is locked. */
+static bool
+range_locked (struct supplemental_page_table *spt, void *start, void *end) {
+	void *va;
+
+	for (va = start; va < end; va += PGSIZE) {
+		struct page *page = spt_find_page(spt, va);
+		if (page != NULL && page->locked) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Handle the fault on write_protected page.
+ * PAGE is writable but mapped read-only because fork shares its frame
+ * copy-on-write.  If another page still shares the frame, PAGE gets a
+ * private copy; otherwise write access is simply restored.  The shared
+ * frame is locked in memory while it is copied, so that kswapd cannot
+ * evict it underneath.  If PAGE was evicted before that, nothing is
+ * done: the next write faults it back in. */
 static bool
 vm_handle_wp (struct page *page UNUSED) {
+	struct frame *frame;
+	uint64_t *pml4 = page->owner->pml4;
+
+	lock_acquire(&frame_lock);
+	frame_wait_eviction(page);
+	frame = page->frame;
+	if (frame == NULL) {
+		lock_release(&frame_lock);
+		return true;
+	}
+	if (frame->ref_cnt > 1) {
+		struct frame *copy;
+
+		frame->mlock_cnt++;
+		lock_release(&frame_lock);
+		copy = vm_get_frame();
+		if (frame == &zero_frame) {
+			memset(copy->kva, 0, PGSIZE);
+		} else {
+			memcpy(copy->kva, frame->kva, PGSIZE);
+		}
+		lock_acquire(&frame_lock);
+		frame->mlock_cnt--;
+		/* The other pages may have let go of FRAME meanwhile. */
+		if (frame_remove_page(page) == 0 && frame != &zero_frame) {
+			frame_free(frame);
+		}
+		frame_add_page(copy, page);
+		lock_release(&frame_lock);
+		copy->pinned = false;
+		pml4_clear_page(pml4, page->va);
+		return pml4_set_page(pml4, page->va, copy->kva, true);
+	}
+	lock_release(&frame_lock);
+
+	pml4_set_writable(pml4, page->va, true);
+	return true;
 }
 
+static bool vm_handle_fault (struct intr_frame *f, void *addr, bool write, bool not_present);
+
 /* Return true on success */
 bool
 vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED, bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
 	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page;
+	uint64_t start = rdtsc();
+	uint64_t disk_start = thread_current()->disk_cycles;
+	enum fault_class cls;
+	bool success;
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 	if(is_kernel_vaddr(addr)){
+		fault_stat_record(FAULT_INVALID, rdtsc() - start, 0);
 		return false;
 	}
 
+	lock_acquire(&spt->lock);  // prefetchd가 이 SPT를 채우는 중일 수 있음
+	cls = fault_classify(addr, write, not_present);
+	success = vm_handle_fault(f, addr, write, not_present);
+	lock_release(&spt->lock);
+
+	fault_stat_record(success ? cls : FAULT_INVALID, rdtsc() - start,
+			thread_current()->disk_cycles - disk_start);
+	return success;
+}
+
+/* Returns the class of a fault at ADDR, assuming it is resolved.  A
+ * not-present fault outside any page can only be stack growth. */
+static enum fault_class
+fault_classify (void *addr, bool write, bool not_present) {
+	struct page *page;
+
+	if (!not_present) {
+		return write ? FAULT_WRITE_PROTECT : FAULT_INVALID;
+	}
+	page = spt_get_page(&thread_current()->spt, addr);
+	if (page == NULL) {
+		return FAULT_STACK;
+	}
+	switch (VM_TYPE(page->operations->type)) {
+		case VM_UNINIT:
+			return page_is_zero_fill(page) ? FAULT_LAZY_ANON : FAULT_LAZY_FILE;
+		case VM_ANON:
+			return FAULT_SWAP_IN;
+		default:
+			return FAULT_LAZY_FILE;
+	}
+}
+
+/* Resolves the fault at user address ADDR, with the SPT lock held. */
+static bool
+vm_handle_fault (struct intr_frame *f, void *addr, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page;
+
 	// stack pointer를 가져오는 방법(아까 thread 구조체에 저장했던 이유가 여기나옴)
 	void *rsp_stack = is_kernel_vaddr(f->rsp) ? thread_current()->rsp_stack : f->rsp;
 
 	if(not_present){ // 0: not-present page. 1: access rights violation.
+			if (!write && vm_claim_zero_page(addr)) {  // 읽기만 하면 zero frame 공유
+					vm_count_fault();
+					return true;
+			}
 			if(!vm_claim_page(addr)){
 					if(rsp_stack - 8 <= addr && USER_STACK - 0x100000 <= addr && addr <= USER_STACK){
 							vm_stack_growth(thread_current()->stack_bottom - PGSIZE);
+							vm_count_fault();
 							return true;
 					}
-			} else return true;
+			} else {
+					struct vm_area *area = spt_find_area(spt, addr);
+
+					vm_count_fault();
+					vm_fault_around(addr);
+					if (area != NULL && area->advice == ADV_SEQUENTIAL) {
+							vm_drop_behind(area, pg_round_down(addr));
+					}
+					return true;
+			}
+	} else if (write) {  // read-only로 공유된 page에 쓰기: copy-on-write
+		page = spt_find_page(spt, addr);
+		if (page != NULL && page->writable && page->frame != NULL) {
+			vm_count_fault();
+			return vm_handle_wp(page);
+		}
 	}
 	return false;
 }
@@ -243,80 +1824,726 @@ bool
 vm_claim_page (void *va UNUSED) {
 	struct page *page;
 	/* TODO: Fill this function */
-	page = spt_find_page(&thread_current()->spt, va);
+	page = spt_get_page(&thread_current()->spt, va);
 	if (page == NULL) {
 		return false;
 	}
 	return vm_do_claim_page (page);
 }
 
+/* Maps the zero frame read-only at VA if VA belongs to an anonymous
+ * page that has never been touched and would start out zeroed.
+ * Returns false, leaving the page alone, for any other page. */
+static bool
+vm_claim_zero_page (void *va) {
+	struct page *page = spt_get_page(&thread_current()->spt, va);
+
+	if (page == NULL || !page_is_zero_fill(page)) {
+		return false;
+	}
+	if (!uninit_transmute(page, zero_frame.kva)) {
+		return false;
+	}
+
+	lock_acquire(&frame_lock);
+	frame_add_page(&zero_frame, page);
+	lock_release(&frame_lock);
+	return pml4_set_page(page->owner->pml4, page->va, zero_frame.kva, false);
+}
+
+/* Returns true if PAGE is an untouched anonymous page that would
+ * start out zeroed. */
+static bool
+page_is_zero_fill (struct page *page) {
+	struct lazy_load_info *aux;
+
+	if (VM_TYPE(page->operations->type) != VM_UNINIT
+			|| VM_TYPE(page->uninit.type) != VM_ANON) {
+		return false;
+	}
+	aux = page->uninit.aux;
+	return aux == NULL || aux->read_bytes == 0;
+}
+
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	struct frame *frame;
+	struct vm_area *area;
+	uint64_t *pml4 = page->owner->pml4;
+	bool resident;
+	bool success = false;
+
+	/* The page may be on its way out; once it is, it can come back. */
+	lock_acquire(&frame_lock);
+	frame_wait_eviction(page);
+	resident = page->frame != NULL;
+	lock_release(&frame_lock);
+	if (resident) {
+		return true;
+	}
+
+	area = spt_find_area(&page->owner->spt, page->va);
+	if (area != NULL && VM_TYPE(area->type) == VM_FILE) {
+		return vm_claim_cached(page, area);
+	}
+
+	frame = vm_get_frame ();
 
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	lock_acquire(&frame_lock);
+	frame_add_page(frame, page);
+	lock_release(&frame_lock);
+	clock_admit(frame, page);
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-    if(install_page(page->va, frame->kva, page->writable)){
-        return swap_in(page, frame->kva);
+	/* TODO: Insert page table entry to map page's VA to frame's PA.
+	 * The owner may not be the current thread while forking, or may be
+	 * running while prefetchd claims for it, so the frame is filled
+	 * before it is mapped: the owner must never see its old contents. */
+    if(pml4_get_page(pml4, page->va) == NULL && swap_in(page, frame->kva)){
+        success = pml4_set_page(pml4, page->va, frame->kva, page->writable);
+    }
+    lock_acquire(&frame_lock);
+    if (!success) {
+        frame_remove_page(page);
+        frame_free(frame);
+    } else {
+        frame->pinned = false;
     }
-    return false;
+    lock_release(&frame_lock);
+    return success;
+}
+
+/* Unmaps PAGE from its owner's page table and drops its reference to
+ * the frame, freeing the frame once no other page shares it.  Clearing
+ * the mapping also keeps pml4_destroy() from freeing a shared frame. */
+void
+vm_release_frame (struct page *page) {
+	struct frame *frame;
+
+	lock_acquire(&frame_lock);
+	frame_wait_eviction(page);
+	clock_forget(page);
+	frame = page->frame;
+	if (frame != NULL) {
+		if (page->owner->pml4 != NULL) {
+			pml4_clear_page(page->owner->pml4, page->va);
+		}
+		if (page->locked) {
+			vm_unlock_page(page);
+		}
+		if (frame_remove_page(page) == 0) {
+			frame_free(frame);
+		}
+	}
+	lock_release(&frame_lock);
+}
+
+/* Claims PAGE of the file-backed AREA, program text or a file
+ * mapping.  The frame holding its file data is looked up in the frame
+ * cache and shared if another page has it; otherwise PAGE reads it into
+ * a new frame, which is cached for the next.  Waits while the cached
+ * frame is being filled or evicted.
+ * A text page is keyed by the bytes its segment takes from the file.
+ * A mapped page always holds the whole page of the file, zero past its
+ * end, which is also what a full text page holds, so the two share. */
+static bool
+vm_claim_cached (struct page *page, struct vm_area *area) {
+	uint64_t *pml4 = page->owner->pml4;
+	size_t offset = page->va - area->start;
+	struct frame key, *frame, *spare = NULL;
+	bool fill = false, success;
+
+	key.inode = file_get_inode(area->file);
+	key.ofs = area->ofs + offset;
+	key.read_bytes = !(area->type & VM_TEXT) ? PGSIZE
+			: offset >= area->read_bytes ? 0
+			: area->read_bytes - offset < PGSIZE ? area->read_bytes - offset : PGSIZE;
+
+	lock_acquire(&frame_lock);
+	while ((frame = frame_cache_find(&key)) == NULL || frame->evicting || frame->pinned) {
+		if (frame != NULL) {
+			cond_wait(&evict_done, &frame_lock);
+		} else if (spare != NULL) {
+			/* Nobody beat us to it: cache the new frame. */
+			frame = spare;
+			spare = NULL;
+			frame->inode = key.inode;
+			frame->ofs = key.ofs;
+			frame->read_bytes = key.read_bytes;
+			hash_insert(&frame_cache, &frame->cache_elem);
+			fill = true;
+			break;
+		} else {
+			lock_release(&frame_lock);
+			spare = vm_get_frame();
+			lock_acquire(&frame_lock);
+		}
+	}
+	frame_add_page(frame, page);
+	if (!fill) {
+		clock_forget(page);
+	}
+	if (spare != NULL) {
+		frame_free(spare);
+	}
+	lock_release(&frame_lock);
+
+	if (!fill) {
+		/* Already filled: a new page only needs its type. */
+		success = pml4_set_page(pml4, page->va, frame->kva, page->writable)
+				&& (VM_TYPE(page->operations->type) != VM_UNINIT
+					|| uninit_transmute(page, frame->kva));
+		return success;
+	}
+
+	/* Fill the frame before mapping it, so that the owner, which may be
+	 * running while prefetchd claims for it, never sees old contents.
+	 * Nobody else can have taken the frame while it is pinned. */
+	clock_admit(frame, page);
+	success = swap_in(page, frame->kva)
+			&& pml4_set_page(pml4, page->va, frame->kva, page->writable);
+
+	lock_acquire(&frame_lock);
+	if (!success) {
+		frame_remove_page(page);
+		frame_free(frame);
+	} else {
+		frame->pinned = false;
+	}
+	cond_broadcast(&evict_done, &frame_lock);
+	lock_release(&frame_lock);
+	return success;
+}
+
+/* Returns the cached frame holding the whole page of INODE that
+ * contains OFS, waiting while it is being filled or evicted, or NULL if
+ * no page maps it.  Call with frame_lock held. */
+static struct frame *
+frame_cache_lookup (struct inode *inode, off_t ofs) {
+	struct frame key, *frame;
+
+	key.inode = inode;
+	key.ofs = ofs - ofs % PGSIZE;
+	key.read_bytes = PGSIZE;
+	while ((frame = frame_cache_find(&key)) != NULL && (frame->evicting || frame->pinned)) {
+		cond_wait(&evict_done, &frame_lock);
+	}
+	return frame;
+}
+
+/* Copies SIZE bytes at OFS in INODE, all within one page, from the
+ * frame caching that page into DST.  Returns false, copying nothing,
+ * if no frame caches the page; its data is then on disk.  DST must be
+ * kernel memory, since the copy is made under frame_lock. */
+bool
+vm_cache_read (struct inode *inode, off_t ofs, void *dst, size_t size) {
+	struct frame *frame;
+
+	ASSERT (ofs % PGSIZE + size <= PGSIZE);
+
+	lock_acquire(&frame_lock);
+	frame = frame_cache_lookup(inode, ofs);
+	if (frame != NULL) {
+		memcpy(dst, frame->kva + ofs % PGSIZE, size);
+	}
+	lock_release(&frame_lock);
+	return frame != NULL;
+}
+
+/* Copies SIZE bytes from kernel memory SRC into the frame caching the
+ * page of INODE at OFS, if there is one, after write() has put them on
+ * disk.  The frame is not made dirty. */
+void
+vm_cache_write (struct inode *inode, off_t ofs, const void *src, size_t size) {
+	struct frame *frame;
+
+	ASSERT (ofs % PGSIZE + size <= PGSIZE);
+
+	lock_acquire(&frame_lock);
+	frame = frame_cache_lookup(inode, ofs);
+	if (frame != NULL) {
+		memcpy(frame->kva + ofs % PGSIZE, src, size);
+	}
+	lock_release(&frame_lock);
+}
+
+/* If resident PAGE was written through any page mapping its frame
+ * since it was last cleaned, clears every mapping's dirty bit, copies
+ * the frame to DST and returns true.  The bits are cleared before the
+ * copy is taken, so a write racing with it dirties the frame again. */
+bool
+vm_frame_clean (struct page *page, void *dst) {
+	struct frame *frame;
+	struct list_elem *e;
+	bool dirty = false;
+
+	lock_acquire(&frame_lock);
+	while (page->frame != NULL && (page->frame->evicting || page->frame->pinned)) {
+		cond_wait(&evict_done, &frame_lock);
+	}
+	frame = page->frame;
+	if (frame != NULL) {
+		for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e)) {
+			struct page *p = list_entry(e, struct page, frame_elem);
+			uint64_t *pml4 = p->owner->pml4;
+
+			if (pml4 != NULL && pml4_is_dirty(pml4, p->va)) {
+				pml4_set_dirty(pml4, p->va, false);
+				dirty = true;
+			}
+		}
+		if (dirty) {
+			memcpy(dst, frame->kva, PGSIZE);
+		}
+	}
+	lock_release(&frame_lock);
+	return dirty;
+}
+
+/* Returns the cached frame holding the same file data as KEY, or
+ * NULL.  Call with frame_lock held. */
+static struct frame *
+frame_cache_find (struct frame *key) {
+	struct hash_elem *e = hash_find(&frame_cache, &key->cache_elem);
+
+	return e != NULL ? hash_entry(e, struct frame, cache_elem) : NULL;
+}
+
+static uint64_t
+frame_cache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *f = hash_entry(e, struct frame, cache_elem);
+
+	return hash_bytes(&f->inode, sizeof f->inode) ^ hash_int(f->ofs) ^ hash_int(f->read_bytes);
+}
+
+static bool
+frame_cache_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+	const struct frame *a = hash_entry(a_, struct frame, cache_elem);
+	const struct frame *b = hash_entry(b_, struct frame, cache_elem);
+
+	if (a->inode != b->inode) {
+		return a->inode < b->inode;
+	}
+	if (a->ofs != b->ofs) {
+		return a->ofs < b->ofs;
+	}
+	return a->read_bytes < b->read_bytes;
+}
+
+/* Hash function and comparison for ksm_table, by checksum. */
+static uint64_t
+ksm_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry(e, struct frame, ksm_elem)->ksm_sum;
+}
+
+static bool
+ksm_less (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
+	return hash_entry(a, struct frame, ksm_elem)->ksm_sum
+			< hash_entry(b, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Takes a frame out of ksm_table when the table starts over. */
+static void
+ksm_forget (struct hash_elem *e, void *aux UNUSED) {
+	hash_entry(e, struct frame, ksm_elem)->ksm = false;
+}
+
+/* Frees FRAME, which no page maps any more.  Call with frame_lock
+ * held. */
+static void
+frame_free (struct frame *frame) {
+	ASSERT (frame->ref_cnt == 0);
+
+	if (frame->inode != NULL) {
+		hash_delete(&frame_cache, &frame->cache_elem);
+	}
+	if (frame->ksm) {
+		hash_delete(&ksm_table, &frame->ksm_elem);
+	}
+	clock_remove(frame);
+	frame_cnt--;
+	palloc_free_page(frame->kva);
+	free(frame);
+}
+
+/* Returns the list element after E in frame_table, wrapping around. */
+static struct list_elem *
+clock_next (struct list_elem *e) {
+	e = list_next(e);
+	return e != list_end(&frame_table) ? e : list_begin(&frame_table);
+}
+
+/* Puts FRAME at the head of the clock, just behind the cold hand, so
+ * that it is the last frame the cold hand reaches. */
+static void
+clock_insert (struct frame *frame) {
+	if (hand_cold != NULL) {
+		list_insert(hand_cold, &frame->f_elem);
+	} else {
+		list_push_back(&frame_table, &frame->f_elem);
+	}
+}
+
+/* Moves FRAME to the cold hand, so that it is the next frame the cold
+ * hand inspects. */
+static void
+clock_move_to_hand (struct frame *frame) {
+	if (hand_cold == &frame->f_elem) {
+		return;
+	}
+	clock_remove(frame);
+	if (hand_cold != NULL) {
+		list_insert(hand_cold, &frame->f_elem);
+	} else {
+		list_push_back(&frame_table, &frame->f_elem);
+	}
+	hand_cold = &frame->f_elem;
+}
+
+/* Takes FRAME off the clock, moving any hand that points at it. */
+static void
+clock_remove (struct frame *frame) {
+	struct list_elem *next = list_next(&frame->f_elem);
+
+	if (frame->hot) {
+		frame->hot = false;
+		hot_cnt--;
+	}
+	if (next == list_end(&frame_table)) {
+		next = list_begin(&frame_table);
+	}
+	if (next == &frame->f_elem) {  // 마지막 frame
+		next = NULL;
+	}
+	if (hand_cold == &frame->f_elem) {
+		hand_cold = next;
+	}
+	if (hand_hot == &frame->f_elem) {
+		hand_hot = next;
+	}
+	if (hand_ksm == &frame->f_elem) {  // ksmd의 hand는 한 바퀴에서 멈춤
+		hand_ksm = list_next(hand_ksm) != list_end(&frame_table) ? list_next(hand_ksm) : NULL;
+	}
+	list_remove(&frame->f_elem);
+}
+
+/* Decides the temperature of FRAME, just filled with PAGE.  A page
+ * faulting back within its test period had a short reuse distance, so
+ * it starts hot and the cold share grows; any other page starts cold
+ * in a new test period. */
+static void
+clock_admit (struct frame *frame, struct page *page) {
+	lock_acquire(&frame_lock);
+	if (page->clock_test) {
+		clock_forget(page);
+		frame->hot = true;
+		hot_cnt++;
+		if (cold_target < frame_cnt) {
+			cold_target++;
+		}
+		clock_run_hot_hand();
+	} else {
+		frame->test = true;
+	}
+	lock_release(&frame_lock);
+}
+
+/* Ends the test period of non-resident PAGE, if it has one. */
+static void
+clock_forget (struct page *page) {
+	if (page->clock_test) {
+		list_remove(&page->test_elem);
+		page->clock_test = false;
+		test_cnt--;
+	}
+}
+
+/* Sweeps the hot hand while hot frames exceed their share, demoting
+ * unreferenced hot frames to cold.  Cold frames the hand passes lose
+ * their test period. */
+static void
+clock_run_hot_hand (void) {
+	size_t cold_min = cold_target > 0 ? cold_target : 1;
+
+	while (hot_cnt > 0 && hot_cnt + cold_min > frame_cnt) {
+		struct frame *frame;
+
+		if (hand_hot == NULL) {
+			hand_hot = list_begin(&frame_table);
+		}
+		frame = elem_to_frame(hand_hot);
+		hand_hot = clock_next(hand_hot);
+		if (frame->page == NULL) {
+			continue;
+		}
+		if (!frame->hot) {
+			frame->test = false;
+		} else if (!frame_is_accessed(frame)) {
+			frame->hot = false;
+			hot_cnt--;
+		}
+	}
+}
+
+/* Returns true if any page mapping FRAME was referenced since the last
+ * check, clearing the accessed bits in every owner's page table. */
+static bool
+frame_is_accessed (struct frame *frame) {
+	bool accessed = frame->referenced;
+	struct list_elem *e;
+
+	frame->referenced = false;
+	for (e = list_begin(&frame->pages); e != list_end(&frame->pages); e = list_next(e)) {
+		struct page *page = list_entry(e, struct page, frame_elem);
+		uint64_t *pml4 = page->owner->pml4;
+
+		if (pml4 != NULL && pml4_is_accessed(pml4, page->va)) {
+			pml4_set_accessed(pml4, page->va, NOT_ACCESSED);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Links PAGE to FRAME as one more page mapping it.  A page just
+ * mapped counts as referenced in its owner's working set. */
+static void
+frame_add_page (struct frame *frame, struct page *page) {
+	list_push_back(&frame->pages, &page->frame_elem);
+	frame->ref_cnt++;
+	if (page->locked) {
+		frame->mlock_cnt++;
+	}
+	if (frame->page == NULL) {
+		frame->page = page;
+	}
+	page->frame = frame;
+	page->ws_epoch = ws_epoch;
+	if (frame != &zero_frame) {
+		page->owner->rss++;
+	}
+}
+
+/* Unlinks PAGE from its frame and returns how many pages still map
+ * the frame.  FRAME->PAGE moves on to one of the remaining pages. */
+static int
+frame_remove_page (struct page *page) {
+	struct frame *frame = page->frame;
+
+	list_remove(&page->frame_elem);
+	page->frame = NULL;
+	frame->ref_cnt--;
+	if (page->locked) {
+		frame->mlock_cnt--;
+	}
+	if (frame != &zero_frame) {
+		page->owner->rss--;
+	}
+	if (page->merged) {
+		page->merged = false;
+		ksm_saved--;
+	}
+	if (frame->page == page) {
+		frame->page = list_empty(&frame->pages) ? NULL
+				: list_entry(list_front(&frame->pages), struct page, frame_elem);
+	}
+	return frame->ref_cnt;
 }
 
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 	hash_init(&spt->spt_hash, page_hash, page_less, NULL);
+	lock_init(&spt->lock);
+	spt->areas = NULL;
+	spt->area_cnt = 0;
+	spt->area_cap = 0;
 }
 
-/* Copy supplemental page table from src to dst */
+/* A file of the parent paired with the child's handle for it, so that
+ * every page of one mapping keeps referring to the same struct file. */
+struct fork_file {
+	struct file *parent;
+	struct file *child;
+	struct list_elem elem;
+};
+
+static struct file *fork_file (struct list *files, struct file *file);
+static bool spt_copy_area (struct supplemental_page_table *dst, struct vm_area *parent_area, struct list *files);
+static bool spt_copy_page (struct supplemental_page_table *dst, struct page *parent_page, struct list *files);
+
+/* Copy supplemental page table from src to dst.
+ * Resident pages are not copied: the child maps the parent's frame.
+ * File pages keep sharing it, as every mapping of the file does;
+ * anonymous pages become read-only in both until the first write,
+ * which is resolved by vm_handle_wp(). */
 bool
 supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED, struct supplemental_page_table *src UNUSED) {
-	/* TODO: copy the supplemental page table for fork */
+	struct thread *cur = thread_current();
+	struct fork_file running;
+	struct list files;
 	struct hash_iterator i;
+	bool success = true;
+
+	/* __do_fork already duplicated the executable. */
+	list_init(&files);
+	running.parent = cur->parent->running;
+	running.child = cur->running;
+	list_push_back(&files, &running.elem);
+
+	lock_acquire(&src->lock);
+	for (size_t j = 0; success && j < src->area_cnt; j++) {
+		success = spt_copy_area(dst, src->areas[j], &files);
+	}
+
 	hash_first(&i, &src->spt_hash);
-	while(hash_next(&i)) {
-		struct page *parent_page = h_elem_to_page(hash_cur(&i));
-		// FIXME: 각 타입의 page type에 맞는 struct 완성시 조건문에 type 활용
-		enum vm_type type = page_get_type(parent_page);
-		void *upage = parent_page->va;
-		bool writable = parent_page->writable;
-
-		if (parent_page->uninit.type & VM_MARKER_0) {  // stack page인 경우
-			setup_stack(&thread_current()->tf);
-		} else if (parent_page->operations->type == VM_UNINIT) {  // uninit page인 경우
-			vm_initializer *initializer = parent_page->uninit.init;
-			struct lazy_load_info *aux = (struct lazy_load_info *)malloc(sizeof (struct lazy_load_info));
-			memcpy(aux, parent_page->uninit.aux, sizeof(struct lazy_load_info));
-			if (!vm_alloc_page_with_initializer(type, upage, writable, initializer, aux)) {
+	while (success && hash_next(&i)) {
+		success = spt_copy_page(dst, h_elem_to_page(hash_cur(&i)), &files);
+	}
+	lock_release(&src->lock);
+
+	while (list_back(&files) != &running.elem) {
+		free(list_entry(list_pop_back(&files), struct fork_file, elem));
+	}
+	return success;
+}
+
+/* Returns the child's handle for the parent's FILE, reopening it the
+ * first time it is seen.  Returns NULL if reopening fails. */
+static struct file *
+fork_file (struct list *files, struct file *file) {
+	struct list_elem *e;
+	struct fork_file *ff;
+
+	for (e = list_begin(files); e != list_end(files); e = list_next(e)) {
+		ff = list_entry(e, struct fork_file, elem);
+		if (ff->parent == file) {
+			return ff->child;
+		}
+	}
+
+	ff = malloc(sizeof *ff);
+	if (ff == NULL) {
+		return NULL;
+	}
+	ff->parent = file;
+	ff->child = file_reopen(file);
+	if (ff->child == NULL) {
+		free(ff);
+		return NULL;
+	}
+	list_push_back(files, &ff->elem);
+	return ff->child;
+}
+
+/* Duplicates PARENT_AREA into DST, backed by the child's files. */
+static bool
+spt_copy_area (struct supplemental_page_table *dst, struct vm_area *parent_area, struct list *files) {
+	struct vm_area *area = malloc(sizeof *area);
+
+	if (area == NULL) {
+		return false;
+	}
+	*area = *parent_area;
+	if (area->file != NULL) {
+		area->file = fork_file(files, area->file);
+		if (area->file == NULL) {
+			free(area);
+			return false;
+		}
+	}
+	if (!spt_insert_area(dst, area)) {
+		free(area);
+		return false;
+	}
+	return true;
+}
+
+/* Duplicates PARENT_PAGE into DST for the current (child) thread. */
+static bool
+spt_copy_page (struct supplemental_page_table *dst, struct page *parent_page, struct list *files) {
+	struct thread *cur = thread_current();
+	enum vm_type type = VM_TYPE(parent_page->operations->type);
+	void *upage = parent_page->va;
+	struct page *child_page;
+	struct frame *frame;
+	bool success = true;
+
+	if (type == VM_UNINIT) {  // uninit page인 경우: lazy load 정보만 복사
+		struct lazy_load_info *aux = NULL;
+
+		if (parent_page->uninit.aux != NULL) {
+			aux = (struct lazy_load_info *)malloc(sizeof (struct lazy_load_info));
+			if (aux == NULL) {
 				return false;
 			}
-		} 
-		else if (parent_page->operations->type == VM_ANON) {
-			if (!vm_alloc_page(type, upage, writable) || !vm_claim_page(upage)) {
+			memcpy(aux, parent_page->uninit.aux, sizeof(struct lazy_load_info));
+			aux->file = fork_file(files, aux->file);
+			if (aux->file == NULL) {
+				free(aux);
 				return false;
 			}
-		} else {  // VM_FILE일 때
-			if (parent_page->file.header) {  // header page인 경우
-				if (!vm_alloc_page(type | VM_MARKER_1, upage, writable) || !vm_claim_page(upage)) {
-					return false;
-				}
-			} else {  // header page가 아닌 경우
-				if (!vm_alloc_page(type, upage, writable) || !vm_claim_page(upage)) {
-					return false;
-				}
-			}
 		}
+		return vm_alloc_page_with_initializer(parent_page->uninit.type, upage, parent_page->writable, parent_page->uninit.init, aux);
+	}
+
+	child_page = (struct page *)malloc(sizeof(struct page));
+	if (child_page == NULL) {
+		return false;
+	}
+	memcpy(child_page, parent_page, sizeof(struct page));
+	child_page->owner = cur;
+	child_page->frame = NULL;
+	child_page->clock_test = false;
+	child_page->merged = false;
+	child_page->locked = false;
+	if (type == VM_ANON) {
+		child_page->anon.lazy_free = false;
+	}
+	if (type == VM_FILE) {
+		child_page->file.file = fork_file(files, parent_page->file.file);
+		if (child_page->file.file == NULL) {
+			free(child_page);
+			return false;
+		}
+	}
+	if (!spt_insert_page(dst, child_page)) {
+		free(child_page);
+		return false;
+	}
 
-		if (parent_page->operations->type != VM_UNINIT) {
-			struct page *child_page = spt_find_page(dst, upage);
-			memcpy(child_page->frame->kva, parent_page->frame->kva, PGSIZE);  // mapping된 frame에 부모의 frame 내용 복사
+	/* A swapped-out anon page must be brought back before it can be
+	 * shared.  The frame must not be on its way out either, or the
+	 * eviction would drop the child's page without a copy. */
+	lock_acquire(&frame_lock);
+	for (;;) {
+		frame_wait_eviction(parent_page);
+		frame = parent_page->frame;
+		if (frame != NULL || type != VM_ANON) {
+			break;
+		}
+		lock_release(&frame_lock);
+		if (!vm_do_claim_page(parent_page)) {
+			return false;
 		}
+		lock_acquire(&frame_lock);
 	}
-	return true;
+	if (frame != NULL) {
+		/* A file page shares the frame outright; any other page shares
+		 * it read-only until the first write. */
+		bool shared = type == VM_FILE;
+
+		if (!shared) {
+			pml4_set_writable(parent_page->owner->pml4, upage, false);
+		}
+		success = pml4_set_page(cur->pml4, upage, frame->kva, shared && parent_page->writable);
+		if (success) {
+			frame_add_page(frame, child_page);
+		}
+	}
+	lock_release(&frame_lock);
+	return success;
 }
 
 /* Free the resource hold by the supplemental page table */
@@ -324,14 +2551,27 @@ void
 supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
-	struct list *h_list = &thread_current()->head_list;
+	size_t i = spt->area_cnt;
 
-	while (!list_empty(h_list)) {
-		do_munmap(list_entry(list_front(h_list), struct page, head_elem)->va);
+	prefetch_cancel(thread_current());
+	thread_current()->mlock_future = false;
+
+	/* do_munmap은 areas[i]를 빼고 그 뒤의 area만 앞으로 당기므로,
+	 * 뒤에서부터 돌면 아직 보지 않은 앞쪽 index는 그대로다 */
+	while (i-- > 0) {
+		if (VM_TYPE(spt->areas[i]->type) == VM_FILE && !(spt->areas[i]->type & VM_TEXT)) {
+			do_munmap(spt->areas[i]->start);
+		}
 	}
 
 	hash_clear(&spt->spt_hash, spt_destructor);
-	// hash_destroy(&spt->spt_hash, spt_destructor);
+	for (i = 0; i < spt->area_cnt; i++) {
+		free(spt->areas[i]);
+	}
+	free(spt->areas);
+	spt->areas = NULL;
+	spt->area_cnt = 0;
+	spt->area_cap = 0;
 }
 
 void spt_destructor(struct hash_elem *e, void* aux){
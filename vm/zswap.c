@@ -0,0 +1,345 @@
+/* zswap.c: Compressed in-memory store in front of the swap disk.
+ *
+ * Anonymous pages on their way to swap are compressed into kernel
+ * pool memory first, and only the oldest ones are written to the
+ * swap disk once the store grows past its budget.  A page made of a
+ * single repeated word (most often all zeros) is kept as that word
+ * alone.  Other pages are compressed with a small LZ77 coder and
+ * packed two to a kernel page, one from each end ("zbud").
+ *
+ * The store keeps no lock of its own: anon.c calls in with its
+ * swap_lock held, which also keeps each entry's page stable. */
+
+#include "vm/zswap.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Pages that do not compress to at most this many bytes go
+ * straight to the swap disk. */
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+/* A kernel page holding up to two compressed pages. */
+struct zbud_page {
+	uint8_t *kva;               /* The kernel page. */
+	size_t first;               /* Bytes used from the front. */
+	size_t last;                /* Bytes used from the back. */
+	struct list_elem elem;      /* Element in zbud_pages. */
+};
+
+/* A page held by the store. */
+struct zswap_entry {
+	struct page *page;          /* Page whose contents these are. */
+	struct zbud_page *zpage;    /* Compressed data, NULL if same-filled. */
+	bool back;                  /* Data sits at the back of ZPAGE. */
+	size_t len;                 /* Compressed length. */
+	uint64_t fill;              /* Repeated word of a same-filled page. */
+	struct list_elem elem;      /* Element in entries, oldest first. */
+};
+
+static struct list entries;     /* Stored pages, oldest first. */
+static struct list zbud_pages;  /* Kernel pages backing compressed data. */
+static size_t entry_cnt;        /* Entries in ENTRIES. */
+static size_t zbud_cnt;         /* Pages in ZBUD_PAGES. */
+static size_t budget;           /* Most bytes the store may occupy. */
+
+/* Scratch space, used under the caller's lock. */
+static uint8_t lz_out[ZSWAP_MAX_LEN];
+#define LZ_HASH_BITS 12
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+/* Statistics. */
+static long long store_cnt;     /* Pages stored. */
+static long long same_cnt;      /* ...of which same-filled. */
+static long long reject_cnt;    /* Pages that did not compress. */
+static long long in_bytes;      /* Bytes before compression. */
+static long long out_bytes;     /* Bytes after compression. */
+static long long hit_cnt;       /* Swap-ins served from the store. */
+static long long miss_cnt;      /* Swap-ins that went to disk. */
+static long long writeback_cnt; /* Pages moved on to the swap disk. */
+
+static void zswap_unpack (const struct zswap_entry *e, void *kva);
+static size_t lz_compress (const uint8_t *src, uint8_t *dst, size_t limit);
+static void lz_decompress (const uint8_t *src, size_t len, uint8_t *dst);
+static struct zbud_page *zbud_alloc (size_t len, bool *back);
+static void zbud_free (struct zbud_page *zpage, bool back);
+
+/* Sets up the store, allowing it an eighth of the kernel pool. */
+void
+zswap_init (void) {
+	list_init (&entries);
+	list_init (&zbud_pages);
+	budget = palloc_free_cnt (0) / 8 * PGSIZE;
+}
+
+/* Compresses the page at KVA, the contents of PAGE, into the store.
+ * Returns the new entry, or NULL if the page does not compress well
+ * or memory ran out; the page must then go to the swap disk. */
+struct zswap_entry *
+zswap_store (const void *kva, struct page *page) {
+	const uint64_t *words = kva;
+	struct zswap_entry *e;
+	size_t i;
+
+	e = malloc (sizeof *e);
+	if (e == NULL)
+		return NULL;
+	e->page = page;
+	e->zpage = NULL;
+	e->back = false;
+
+	for (i = 1; i < PGSIZE / sizeof *words; i++)
+		if (words[i] != words[0])
+			break;
+	if (i == PGSIZE / sizeof *words) {
+		e->len = 0;
+		e->fill = words[0];
+		same_cnt++;
+		out_bytes += sizeof e->fill;
+	} else {
+		e->len = lz_compress (kva, lz_out, ZSWAP_MAX_LEN);
+		if (e->len != 0)
+			e->zpage = zbud_alloc (e->len, &e->back);
+		if (e->zpage == NULL) {
+			free (e);
+			reject_cnt++;
+			return NULL;
+		}
+		memcpy (e->zpage->kva + (e->back ? PGSIZE - e->len : 0), lz_out, e->len);
+		out_bytes += e->len;
+	}
+
+	list_push_back (&entries, &e->elem);
+	entry_cnt++;
+	store_cnt++;
+	in_bytes += PGSIZE;
+	return e;
+}
+
+/* Decompresses ENTRY into the page at KVA and returns true.  ENTRY
+ * stays in the store until zswap_free().  A null ENTRY only counts
+ * a swap-in that missed the store, and returns false. */
+bool
+zswap_load (struct zswap_entry *e, void *kva) {
+	if (e == NULL) {
+		miss_cnt++;
+		return false;
+	}
+
+	zswap_unpack (e, kva);
+	hit_cnt++;
+	return true;
+}
+
+/* Removes ENTRY from the store and frees it. */
+void
+zswap_free (struct zswap_entry *e) {
+	if (e->zpage != NULL)
+		zbud_free (e->zpage, e->back);
+	list_remove (&e->elem);
+	entry_cnt--;
+	free (e);
+}
+
+/* Removes the entry stored longest ago, so that its page can be
+ * written to the swap disk: decompresses it into KVA and returns its
+ * page, or returns NULL if the store is empty. */
+struct page *
+zswap_writeback (void *kva) {
+	struct zswap_entry *e;
+	struct page *page;
+
+	if (list_empty (&entries))
+		return NULL;
+	e = list_entry (list_front (&entries), struct zswap_entry, elem);
+	page = e->page;
+	zswap_unpack (e, kva);
+	zswap_free (e);
+	writeback_cnt++;
+	return page;
+}
+
+/* Returns true if the store occupies more than its budget, counting
+ * both its kernel pages and its entries. */
+bool
+zswap_over_budget (void) {
+	return zbud_cnt * PGSIZE + entry_cnt * sizeof (struct zswap_entry) > budget;
+}
+
+/* Prints store statistics. */
+void
+zswap_print_stats (void) {
+	long long ratio = out_bytes > 0 ? in_bytes * 100 / out_bytes : 0;
+	long long loads = hit_cnt + miss_cnt;
+
+	printf ("zswap: %lld pages stored (%lld same-filled, %lld rejected), "
+			"compression ratio %lld.%02lld, %lld of %lld swap-ins hit (%lld%%), "
+			"%lld written back\n",
+			store_cnt, same_cnt, reject_cnt, ratio / 100, ratio % 100,
+			hit_cnt, loads, loads > 0 ? hit_cnt * 100 / loads : 0, writeback_cnt);
+}
+
+/* Restores the page held by E into KVA. */
+static void
+zswap_unpack (const struct zswap_entry *e, void *kva) {
+	if (e->zpage == NULL) {
+		uint64_t *words = kva;
+		size_t i;
+
+		for (i = 0; i < PGSIZE / sizeof *words; i++)
+			words[i] = e->fill;
+	} else
+		lz_decompress (e->zpage->kva + (e->back ? PGSIZE - e->len : 0), e->len, kva);
+}
+
+/* Finds room for LEN bytes in a zbud page, preferring the free half
+ * of a page already in use.  Sets *BACK to the end the data goes
+ * at.  Returns NULL if a new kernel page is needed but unavailable. */
+static struct zbud_page *
+zbud_alloc (size_t len, bool *back) {
+	struct zbud_page *zpage;
+	struct list_elem *el;
+
+	for (el = list_begin (&zbud_pages); el != list_end (&zbud_pages); el = list_next (el)) {
+		zpage = list_entry (el, struct zbud_page, elem);
+		if ((zpage->first == 0 || zpage->last == 0)
+				&& PGSIZE - zpage->first - zpage->last >= len) {
+			*back = zpage->first != 0;
+			if (*back)
+				zpage->last = len;
+			else
+				zpage->first = len;
+			return zpage;
+		}
+	}
+
+	zpage = malloc (sizeof *zpage);
+	if (zpage == NULL)
+		return NULL;
+	zpage->kva = palloc_get_page (0);
+	if (zpage->kva == NULL) {
+		free (zpage);
+		return NULL;
+	}
+	zpage->first = len;
+	zpage->last = 0;
+	list_push_back (&zbud_pages, &zpage->elem);
+	zbud_cnt++;
+	*back = false;
+	return zpage;
+}
+
+/* Releases one end of ZPAGE, and the page itself once both ends
+ * are free. */
+static void
+zbud_free (struct zbud_page *zpage, bool back) {
+	if (back)
+		zpage->last = 0;
+	else
+		zpage->first = 0;
+	if (zpage->first == 0 && zpage->last == 0) {
+		list_remove (&zpage->elem);
+		zbud_cnt--;
+		palloc_free_page (zpage->kva);
+		free (zpage);
+	}
+}
+
+/* LZ77 coder.  The output is a sequence of groups: a flag byte,
+ * then eight items, each a literal byte (flag bit clear) or a match
+ * (flag bit set) of two bytes holding a 12-bit distance and a 4-bit
+ * length minus 3, with one more length byte if those 4 bits are all
+ * set.  Matches are found through a hash of the next three bytes. */
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15 + 255)
+#define LZ_MAX_DIST 4095
+
+static inline size_t
+lz_hash (const uint8_t *p) {
+	uint32_t v = p[0] | p[1] << 8 | p[2] << 16;
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Compresses the page at SRC into DST.  Returns the compressed
+ * length, or 0 if it would exceed LIMIT bytes. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t limit) {
+	const uint8_t *ip = src, *end = src + PGSIZE;
+	size_t op = 0;
+
+	memset (lz_table, 0, sizeof lz_table);
+	while (ip < end) {
+		size_t ctrl = op++;
+		uint8_t flags = 0;
+		int bit;
+
+		for (bit = 0; bit < 8 && ip < end; bit++) {
+			if (end - ip >= LZ_MIN_MATCH) {
+				size_t h = lz_hash (ip);
+				const uint8_t *cand = src + lz_table[h];
+				size_t dist = ip - cand;
+
+				lz_table[h] = ip - src;
+				if (cand < ip && dist <= LZ_MAX_DIST
+						&& cand[0] == ip[0] && cand[1] == ip[1] && cand[2] == ip[2]) {
+					size_t max = end - ip < LZ_MAX_MATCH ? (size_t) (end - ip) : LZ_MAX_MATCH;
+					size_t len = LZ_MIN_MATCH;
+
+					while (len < max && cand[len] == ip[len])
+						len++;
+					if (op + 3 > limit)
+						return 0;
+					dst[op++] = dist >> 4;
+					if (len - LZ_MIN_MATCH >= 15) {
+						dst[op++] = (dist & 0xf) << 4 | 15;
+						dst[op++] = len - LZ_MIN_MATCH - 15;
+					} else
+						dst[op++] = (dist & 0xf) << 4 | (len - LZ_MIN_MATCH);
+					flags |= 1 << bit;
+					ip += len;
+					continue;
+				}
+			}
+			if (op + 1 > limit)
+				return 0;
+			dst[op++] = *ip++;
+		}
+		dst[ctrl] = flags;
+	}
+	return op;
+}
+
+/* Decompresses LEN bytes at SRC, made by lz_compress(), into the
+ * page at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst) {
+	const uint8_t *ip = src, *end = src + len;
+	uint8_t *op = dst;
+
+	while (ip < end) {
+		uint8_t flags = *ip++;
+		int bit;
+
+		for (bit = 0; bit < 8 && ip < end; bit++) {
+			if (flags & (1 << bit)) {
+				size_t dist = ip[0] << 4 | ip[1] >> 4;
+				size_t mlen = (ip[1] & 0xf) + LZ_MIN_MATCH;
+				const uint8_t *m;
+
+				ip += 2;
+				if (mlen == LZ_MIN_MATCH + 15)
+					mlen += *ip++;
+				/* Byte by byte: a match may overlap its own output. */
+				for (m = op - dist; mlen > 0; mlen--)
+					*op++ = *m++;
+			} else
+				*op++ = *ip++;
+		}
+	}
+	ASSERT (op == dst + PGSIZE);
+}